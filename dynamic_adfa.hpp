@@ -0,0 +1,554 @@
+//
+// Created by shibh308 on 2026/10/16.
+//
+
+#ifndef PACKED_ADFA_DYNAMIC_ADFA_HPP
+#define PACKED_ADFA_DYNAMIC_ADFA_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include "utils.hpp"
+#include "trie.hpp"
+
+// a minimal ADFA that stays minimal under insert and erase (Carrasco and Forcada, incremental construction and maintenance
+// of minimal finite-state automata). Every live state except the root and the sink is in the register, keyed by its signature.
+// An update first makes the states on the path of the key private to it: the ones reached through a single edge are taken out
+// of the register, and from the first confluence state (in-degree > 1) on they are replaced by clones, so the other keys through
+// them stay intact. Then the path is changed and minimized bottom-up: a state equal to a registered one is replaced by it.
+class IncrementalADFA{
+  using Edges = std::vector<std::pair<Char, Index>>;
+  static constexpr Index ROOT = 0;
+  static constexpr Index SINK = 1;
+  std::vector<Edges> states;
+  std::vector<Index> in_degree;
+  std::vector<Index> free_ids;
+  // signature hash -> state
+  std::unordered_multimap<std::uint64_t, Index> registry;
+  std::vector<std::uint64_t> signature;
+  Index num_keys = 0;
+  std::uint64_t hash_of(Index s){
+    signature.clear();
+    for(auto [ch, to] : states[s]){
+      signature.emplace_back(pack_edge(ch, to));
+    }
+    return hash_signature(signature);
+  }
+  void register_state(Index s){
+    registry.emplace(hash_of(s), s);
+  }
+  void unregister(Index s){
+    auto [first, last] = registry.equal_range(hash_of(s));
+    for(auto it = first; it != last; ++it){
+      if(it->second == s){
+        registry.erase(it);
+        return;
+      }
+    }
+    assert(("the state is not registered", false));
+  }
+  // a registered state with the same edges as s, NOT_FOUND if there is none
+  Index find_equivalent(Index s){
+    auto [first, last] = registry.equal_range(hash_of(s));
+    for(auto it = first; it != last; ++it){
+      if(it->second != s && states[it->second] == states[s]){
+        return it->second;
+      }
+    }
+    return NOT_FOUND;
+  }
+  Index new_state(const Edges& edges){
+    Index s;
+    if(free_ids.empty()){
+      s = states.size();
+      states.emplace_back();
+      in_degree.emplace_back(0);
+    }
+    else{
+      s = free_ids.back();
+      free_ids.pop_back();
+    }
+    states[s] = edges;
+    for(auto [ch, to] : edges){
+      ++in_degree[to];
+    }
+    return s;
+  }
+  void delete_state(Index s){
+    for(auto [ch, to] : states[s]){
+      --in_degree[to];
+    }
+    states[s].clear();
+    states[s].shrink_to_fit();
+    in_degree[s] = 0;
+    free_ids.emplace_back(s);
+  }
+  Edges::iterator find_edge(Index s, Char ch){
+    return std::lower_bound(states[s].begin(), states[s].end(), ch, [](const std::pair<Char, Index>& edge, Char key){
+      return edge.first < key;
+    });
+  }
+  // points the edge of s labeled ch to `to` (adding it if needed) and moves the in-degree
+  void set_child(Index s, Char ch, Index to){
+    auto it = find_edge(s, ch);
+    if(it != states[s].end() && it->first == ch){
+      --in_degree[it->second];
+      it->second = to;
+    }
+    else{
+      states[s].emplace(it, ch, to);
+    }
+    ++in_degree[to];
+  }
+  void remove_child(Index s, Char ch){
+    auto it = find_edge(s, ch);
+    assert(it != states[s].end() && it->first == ch);
+    --in_degree[it->second];
+    states[s].erase(it);
+  }
+  // the states from the root along line as far as they exist: path[d] is reached by the first d characters
+  std::vector<Index> walk(StringView line) const{
+    std::vector<Index> path{ROOT};
+    for(Char ch : line){
+      Index to = child(path.back(), ch);
+      if(to == NOT_FOUND){
+        break;
+      }
+      path.emplace_back(to);
+    }
+    return path;
+  }
+  // makes path[1..] private to line (see the class comment); the sink must not be on the path
+  void detach(std::vector<Index>& path, StringView line){
+    std::size_t d = 1;
+    for(; d < path.size() && in_degree[path[d]] == 1; ++d){
+      unregister(path[d]);
+    }
+    for(; d < path.size(); ++d){
+      Index clone = new_state(states[path[d]]);
+      set_child(path[d - 1], line[d - 1], clone);
+      path[d] = clone;
+    }
+  }
+  // registers the states of a detached path bottom-up or replaces them by an equivalent registered state.
+  // States left without edges (by erase) are removed. The root is never registered: no other state has its language.
+  void minimize(const std::vector<Index>& path, StringView line){
+    for(std::size_t d = path.size(); d-- > 1;){
+      Index s = path[d];
+      if(states[s].empty()){
+        remove_child(path[d - 1], line[d - 1]);
+        delete_state(s);
+        continue;
+      }
+      Index equivalent = find_equivalent(s);
+      if(equivalent == NOT_FOUND){
+        register_state(s);
+        continue;
+      }
+      set_child(path[d - 1], line[d - 1], equivalent);
+      delete_state(s);
+    }
+  }
+public:
+  IncrementalADFA() : states(2), in_degree(2, 0){}
+  // takes over a minimal ADFA (root = 0, sink = size - 1)
+  explicit IncrementalADFA(const BaseADFA& adfa) : IncrementalADFA(){
+    std::vector<Edges> data = adfa.to_vector();
+    Index n = data.size();
+    if(n <= 1){
+      return;
+    }
+    auto id = [&](Index i){
+      return i == 0 ? ROOT : i == n - 1 ? SINK : i + 1;
+    };
+    states.resize(n);
+    in_degree.resize(n, 0);
+    for(Index i = 0; i < n; ++i){
+      Edges& edges = states[id(i)];
+      edges = std::move(data[i]);
+      for(auto& [ch, to] : edges){
+        to = id(to);
+        ++in_degree[to];
+      }
+    }
+    for(Index s = SINK + 1; s < n; ++s){
+      register_state(s);
+    }
+    // the number of paths from every state to the sink, children first
+    std::vector<Index> number_of_paths(n, 0);
+    number_of_paths[n - 1] = 1;
+    for(Index i = n - 1; i >= 0; --i){
+      for(auto [ch, to] : states[id(i)]){
+        number_of_paths[i] += number_of_paths[to == SINK ? n - 1 : to == ROOT ? 0 : to - 1];
+      }
+    }
+    num_keys = number_of_paths[0];
+  }
+  Index child(Index s, Char ch) const{
+    auto it = std::lower_bound(states[s].begin(), states[s].end(), ch, [](const std::pair<Char, Index>& edge, Char key){
+      return edge.first < key;
+    });
+    return it != states[s].end() && it->first == ch ? it->second : NOT_FOUND;
+  }
+  bool search(StringView line) const{
+    Index node = ROOT;
+    for(Char ch : line){
+      node = child(node, ch);
+      if(node == NOT_FOUND){
+        return false;
+      }
+    }
+    return node == SINK;
+  }
+  // adds a key (ending with its only EOW), false if it is already a key
+  bool insert(StringView line){
+    assert(!line.empty() && line.back() == EOW);
+    std::vector<Index> path = walk(line);
+    if(path.back() == SINK){
+      return false;
+    }
+    detach(path, line);
+    for(std::size_t d = path.size() - 1; d < line.size(); ++d){
+      Index to = d + 1 == line.size() ? SINK : new_state({});
+      set_child(path[d], line[d], to);
+      if(to != SINK){
+        path.emplace_back(to);
+      }
+    }
+    minimize(path, line);
+    ++num_keys;
+    return true;
+  }
+  // removes a key, false if it is not a key
+  bool erase(StringView line){
+    std::vector<Index> path = walk(line);
+    if(path.back() != SINK || path.size() != line.size() + 1){
+      return false;
+    }
+    path.pop_back();
+    detach(path, line);
+    remove_child(path.back(), line.back());
+    minimize(path, line);
+    --num_keys;
+    return true;
+  }
+  Index size() const{
+    return num_keys;
+  }
+  // number of live states, the root and the sink included
+  Index num_states() const{
+    return states.size() - free_ids.size();
+  }
+  // the edges with the states renumbered in topological order (root = 0, sink = size - 1), see BaseADFA::construct_from_minimal
+  std::vector<Edges> to_vector() const{
+    // reverse post order of a depth-first search: the sink is the first state to finish, the root the last
+    std::vector<Index> post_order, ids(states.size(), NOT_FOUND);
+    std::vector<std::pair<Index, std::size_t>> stack{{ROOT, 0}};
+    ids[ROOT] = 0;
+    while(!stack.empty()){
+      auto& [s, i] = stack.back();
+      if(i == states[s].size()){
+        post_order.emplace_back(s);
+        stack.pop_back();
+        continue;
+      }
+      Index to = states[s][i++].second;
+      if(ids[to] == NOT_FOUND){
+        ids[to] = 0;
+        stack.emplace_back(to, 0);
+      }
+    }
+    Index n = post_order.size();
+    for(Index i = 0; i < n; ++i){
+      ids[post_order[i]] = n - 1 - i;
+    }
+    std::vector<Edges> data(n);
+    for(Index s : post_order){
+      Edges& edges = data[ids[s]];
+      for(auto [ch, to] : states[s]){
+        edges.emplace_back(ch, ids[to]);
+      }
+    }
+    return data;
+  }
+  std::size_t memory_usage() const{
+    std::size_t memory = states.capacity() * sizeof(Edges) + (in_degree.capacity() + free_ids.capacity()) * sizeof(Index);
+    for(auto& edges : states){
+      memory += edges.capacity() * sizeof(std::pair<Char, Index>);
+    }
+    // a node with the hash, the state and the link, and a bucket
+    memory += registry.size() * (sizeof(std::uint64_t) + sizeof(Index) + sizeof(void*)) + registry.bucket_count() * sizeof(void*);
+    return memory;
+  }
+};
+
+// an updatable ADFA: a static index (DoubleArrayADFA, PathDecomposedDoubleArrayADFA, ...) and a delta of the keys
+// inserted or erased since it was built. The writers keep an IncrementalADFA of the current keys; once the delta reaches
+// merge_threshold keys, a background thread builds a new static index from a copy of it, and the updates that arrive
+// in the meantime become the delta of the new index.
+// The readers see immutable snapshots (static index and delta) published through an atomic shared_ptr, so a search never
+// waits for a writer, and a snapshot stays alive until its last reader drops it (RCU).
+template <typename Static = DoubleArrayADFA<>>
+class DynamicADFA{
+public:
+  // the keys of the updates, append only: a deque never moves its elements, so the views of the published deltas stay valid
+  using KeyStore = std::deque<String>;
+  using Delta = std::vector<std::pair<StringView, bool>>;
+  // the entry of key in a sorted delta, nullptr if there is none
+  static const std::pair<StringView, bool>* find_entry(const Delta& entries, StringView key){
+    auto it = std::lower_bound(entries.begin(), entries.end(), key, [](const std::pair<StringView, bool>& entry, StringView key){
+      return view_less(entry.first, key);
+    });
+    return it != entries.end() && std::ranges::equal(it->first, key) ? &*it : nullptr;
+  }
+  struct Snapshot{
+    std::shared_ptr<const Static> base;
+    // the keys inserted (true) or erased (false) since base was built, in two sorted layers: recent (the last updates)
+    // overrides older, which is shared with the other snapshots
+    std::shared_ptr<const Delta> older;
+    Delta recent;
+    // the stores the views of the delta point into
+    std::vector<std::shared_ptr<const KeyStore>> stores;
+    bool search(StringView line) const{
+      const std::pair<StringView, bool>* entry = find_entry(recent, line);
+      if(entry == nullptr){
+        entry = find_entry(*older, line);
+      }
+      if(entry != nullptr){
+        return entry->second;
+      }
+      return base != nullptr && base->search(line);
+    }
+  };
+private:
+  // the size of the recent layer, which every publication copies, before it is folded into a new older layer
+  static constexpr std::size_t RECENT_LIMIT = 64;
+  std::size_t merge_threshold;
+  // serializes the writers and the publication of merges
+  mutable std::mutex mutex;
+  // notified when a merge has published its index
+  std::condition_variable merged;
+  IncrementalADFA automaton;
+  std::shared_ptr<const Static> base;
+  // the delta of base, as published in the snapshots
+  std::shared_ptr<const Delta> older = std::make_shared<const Delta>();
+  Delta recent;
+  // the number of distinct keys in older and recent
+  std::size_t delta_keys = 0;
+  // the updates since the running merge copied the automaton, in update order
+  Delta pending;
+  // the keys of the updates since the last merge started, and before it while one is running
+  std::shared_ptr<KeyStore> store = std::make_shared<KeyStore>();
+  std::shared_ptr<KeyStore> previous_store;
+  bool merging = false;
+  std::size_t merges = 0;
+  std::thread merger;
+  std::atomic<std::shared_ptr<const Snapshot>> snapshot;
+  static void upsert(Delta& entries, StringView key, bool present){
+    auto it = std::lower_bound(entries.begin(), entries.end(), key, [](const std::pair<StringView, bool>& entry, StringView key){
+      return view_less(entry.first, key);
+    });
+    if(it != entries.end() && std::ranges::equal(it->first, key)){
+      *it = {key, present};
+    }
+    else{
+      entries.emplace(it, key, present);
+    }
+  }
+  // merges recent into a new older layer, the entries of recent win
+  void fold(){
+    auto folded = std::make_shared<Delta>();
+    folded->reserve(older->size() + recent.size());
+    auto it = older->begin();
+    for(auto& entry : recent){
+      for(; it != older->end() && view_less(it->first, entry.first); ++it){
+        folded->emplace_back(*it);
+      }
+      if(it != older->end() && std::ranges::equal(it->first, entry.first)){
+        ++it;
+      }
+      folded->emplace_back(entry);
+    }
+    folded->insert(folded->end(), it, older->end());
+    older = std::move(folded);
+    recent.clear();
+  }
+  static std::shared_ptr<const Static> build(const BaseADFA& adfa){
+    if constexpr(std::is_constructible_v<Static, const BaseADFA&>){
+      return std::make_shared<const Static>(adfa);
+    }
+    else{
+      return std::make_shared<const Static>(PathDecomposedADFA(adfa));
+    }
+  }
+  void publish(){
+    // copies only recent, older and the keys are shared with the previous snapshots
+    std::vector<std::shared_ptr<const KeyStore>> stores{store};
+    if(previous_store != nullptr){
+      stores.emplace_back(previous_store);
+    }
+    snapshot.store(std::make_shared<const Snapshot>(Snapshot{base, older, recent, std::move(stores)}), std::memory_order_release);
+  }
+  // called with the mutex held and no merge running
+  void start_merge(){
+    // the previous merge has published, so its thread has nothing left to do
+    if(merger.joinable()){
+      merger.join();
+    }
+    merging = true;
+    // the delta of the new index will point only into the new store
+    previous_store = std::exchange(store, std::make_shared<KeyStore>());
+    merger = std::thread([this, data = automaton.to_vector()](){
+      std::shared_ptr<const Static> built = data.size() > 1 ? build(BaseADFA::construct_from_minimal(data)) : nullptr;
+      std::lock_guard lock(mutex);
+      // the new delta is the last update of every key since the copy
+      std::stable_sort(pending.begin(), pending.end(), [](const std::pair<StringView, bool>& a, const std::pair<StringView, bool>& b){
+        return view_less(a.first, b.first);
+      });
+      auto delta = std::make_shared<Delta>();
+      for(std::size_t i = 0; i < pending.size(); ++i){
+        if(i + 1 == pending.size() || !std::ranges::equal(pending[i].first, pending[i + 1].first)){
+          delta->emplace_back(pending[i]);
+        }
+      }
+      base = std::move(built);
+      delta_keys = delta->size();
+      older = std::move(delta);
+      recent.clear();
+      pending.clear();
+      previous_store.reset();
+      merging = false;
+      ++merges;
+      publish();
+      merged.notify_all();
+    });
+  }
+  bool update(StringView key, bool present){
+    std::lock_guard lock(mutex);
+    if(!(present ? automaton.insert(key) : automaton.erase(key))){
+      return false;
+    }
+    const std::pair<StringView, bool>* entry = find_entry(recent, key);
+    if(entry == nullptr){
+      entry = find_entry(*older, key);
+    }
+    if(entry == nullptr){
+      ++delta_keys;
+    }
+    // an update of a key of the delta reuses its copy, unless a merge is running: the copy may be in previous_store,
+    // which pending must not point into
+    StringView stored = !merging && entry != nullptr ? entry->first : StringView(store->emplace_back(key.begin(), key.end()));
+    upsert(recent, stored, present);
+    if(recent.size() >= RECENT_LIMIT){
+      fold();
+    }
+    if(merging){
+      pending.emplace_back(stored, present);
+    }
+    publish();
+    if(!merging && delta_keys >= merge_threshold){
+      start_merge();
+    }
+    return true;
+  }
+public:
+  explicit DynamicADFA(const StringViews& keys, std::size_t merge_threshold = 4096) : merge_threshold(merge_threshold){
+    StringViews sorted_keys = keys;
+    std::sort(sorted_keys.begin(), sorted_keys.end(), view_less);
+    sorted_keys.erase(std::unique(sorted_keys.begin(), sorted_keys.end(), [](StringView a, StringView b){
+      return std::ranges::equal(a, b);
+    }), sorted_keys.end());
+    if(!sorted_keys.empty()){
+      BaseADFA adfa = BaseADFA::construct_from_sorted(sorted_keys);
+      automaton = IncrementalADFA(adfa);
+      base = build(adfa);
+    }
+    publish();
+  }
+  DynamicADFA(const DynamicADFA&) = delete;
+  DynamicADFA& operator=(const DynamicADFA&) = delete;
+  ~DynamicADFA(){
+    wait_for_merge();
+    // the merge has published, so its thread has nothing left to do
+    if(merger.joinable()){
+      merger.join();
+    }
+  }
+  // adds a key (ending with EOW), false if it is already a key
+  bool insert(StringView key){
+    return update(key, true);
+  }
+  // removes a key, false if it is not a key
+  bool erase(StringView key){
+    return update(key, false);
+  }
+  bool search(StringView line) const{
+    return snapshot.load(std::memory_order_acquire)->search(line);
+  }
+  // the current snapshot, for readers that run many searches on one consistent state
+  std::shared_ptr<const Snapshot> current() const{
+    return snapshot.load(std::memory_order_acquire);
+  }
+  // waits until the running merge (if any) has published its index
+  void wait_for_merge(){
+    std::unique_lock lock(mutex);
+    merged.wait(lock, [this](){
+      return !merging;
+    });
+  }
+  // merges the delta into the static index now and waits for it
+  void merge(){
+    std::unique_lock lock(mutex);
+    // a writer may start a merge whenever the lock is released, so the wait is repeated under it
+    merged.wait(lock, [this](){
+      return !merging;
+    });
+    if(delta_keys == 0){
+      return;
+    }
+    start_merge();
+    std::size_t target = merges + 1;
+    merged.wait(lock, [this, target](){
+      return merges >= target;
+    });
+  }
+  Index size() const{
+    std::lock_guard lock(mutex);
+    return automaton.size();
+  }
+  Index num_states() const{
+    std::lock_guard lock(mutex);
+    return automaton.num_states();
+  }
+  std::size_t num_merges() const{
+    std::lock_guard lock(mutex);
+    return merges;
+  }
+  std::size_t delta_size() const{
+    std::lock_guard lock(mutex);
+    return delta_keys;
+  }
+  // the method name of the benchmark rows
+  static std::string name(){
+    return "DynamicADFA<" + Static::name() + ">";
+  }
+  std::size_t memory_usage() const{
+    std::lock_guard lock(mutex);
+    std::size_t memory = automaton.memory_usage() + (base != nullptr ? base->memory_usage() : 0);
+    memory += (older->capacity() + recent.capacity() + pending.capacity()) * sizeof(std::pair<StringView, bool>);
+    for(auto& keys : {store, previous_store}){
+      if(keys != nullptr){
+        for(auto& key : *keys){
+          memory += sizeof(String) + key.capacity();
+        }
+      }
+    }
+    return memory;
+  }
+};
+
+#endif //PACKED_ADFA_DYNAMIC_ADFA_HPP
@@ -1,8 +1,119 @@
 #include <iostream>
 #include <cassert>
 #include <cxxabi.h>
+#include <memory>
+#include <barrier>
+#include <sstream>
+#include <optional>
 #include "utils.hpp"
 #include "trie.hpp"
+#include "workload.hpp"
+#include "dynamic_adfa.hpp"
+
+
+struct BenchmarkConfig {
+  // thread counts of the parallel search benchmark (empty: single-threaded only)
+  std::vector<unsigned int> threads;
+  // directory for the on-disk indexes (empty: the mmap benchmark is skipped)
+  std::string mmap_dir;
+  // text scanned by the common prefix search benchmark (empty: the positive patterns joined by newlines)
+  std::string corpus;
+  // untimed passes and timed repeats of the latency benchmark (no repeats: the benchmark is skipped)
+  std::size_t warmup = 1;
+  std::size_t repeats = 3;
+  // count hardware events around the single-threaded search benchmark
+  bool perf = false;
+  // query streams of the search benchmarks
+  WorkloadConfig workload;
+};
+
+BenchmarkConfig benchmark_config;
+
+// prefixes for the predictive search benchmark
+struct PredictiveWorkload {
+  // views into the keys, whose pool is padded for the word-wise reads of get_lcp past the end of a prefix
+  StringViews prefixes;
+  // number of keys that start with one of the prefixes (counted with multiplicity)
+  std::size_t expected_keys = 0;
+};
+
+PredictiveWorkload predictive_workload;
+
+// the method name of the rows of an index: its own name() if it has one, otherwise the demangled name of T
+template <typename T>
+std::string type_name(){
+  if constexpr(requires{ { T::name() } -> std::convertible_to<std::string>; }){
+    return T::name();
+  }
+  std::unique_ptr<char, decltype(&std::free)> name(abi::__cxa_demangle(typeid(T).name(), 0, 0, nullptr), &std::free);
+  return name.get();
+}
+
+// destination of the construction stages, opened once the dataset is known
+std::optional<BuildMetricsCsvWriter> build_metrics_writer;
+
+// the in-memory text of the common prefix search benchmark when no corpus is given
+String scan_sample;
+
+// joins the keys without their EOW by newlines, up to max_bytes bytes
+String make_scan_sample(const StringViews& keys, std::size_t max_bytes){
+  String text;
+  for(auto& key : keys){
+    if(text.size() + key.size() > max_bytes){
+      break;
+    }
+    text.insert(text.end(), key.begin(), key.end() - 1);
+    text.emplace_back('\n');
+  }
+  return text;
+}
+
+// takes the first half of up to `count` evenly spaced keys as prefixes
+PredictiveWorkload make_predictive_workload(const StringViews& keys, std::size_t count){
+  PredictiveWorkload workload;
+  StringViews sorted_keys = keys;
+  std::sort(sorted_keys.begin(), sorted_keys.end(), view_less);
+  std::size_t step = std::max<std::size_t>(1, keys.size() / count);
+  for(std::size_t i = 0; i < keys.size(); i += step){
+    // keys end with EOW, which is not part of the prefix
+    std::size_t len = std::max<std::size_t>(1, (keys[i].size() - 1) / 2);
+    StringView prefix = keys[i].first(len);
+    auto first = std::lower_bound(sorted_keys.begin(), sorted_keys.end(), prefix, view_less);
+    auto last = std::find_if(first, sorted_keys.end(), [&](StringView key){
+      return key.size() < len || !std::equal(prefix.begin(), prefix.end(), key.begin());
+    });
+    workload.expected_keys += last - first;
+    workload.prefixes.emplace_back(prefix);
+  }
+  return workload;
+}
+
+// the edges of the states renumbered in the order a depth-first walk from the root (children in label order) reaches them,
+// so that two constructions of the same minimal ADFA compare equal whatever numbering they chose
+std::vector<std::vector<std::pair<Char, Index>>> canonical_edges(const BaseADFA& adfa){
+  std::vector<std::vector<std::pair<Char, Index>>> data = adfa.to_vector();
+  std::vector<Index> ids(data.size(), NOT_FOUND), order;
+  std::vector<Index> stack{0};
+  while(!stack.empty()){
+    Index node = stack.back();
+    stack.pop_back();
+    if(ids[node] != NOT_FOUND){
+      continue;
+    }
+    ids[node] = order.size();
+    order.emplace_back(node);
+    for(auto it = data[node].rbegin(); it != data[node].rend(); ++it){
+      stack.emplace_back(it->second);
+    }
+  }
+  std::vector<std::vector<std::pair<Char, Index>>> canonical(order.size());
+  for(Index i = 0; i < order.size(); ++i){
+    for(auto [ch, to] : data[order[i]]){
+      canonical[i].emplace_back(ch, ids[to]);
+    }
+  }
+  return canonical;
+}
 
 
 template <typename, typename = std::void_t<>>
@@ -21,116 +132,879 @@ std::size_t call_memory_usage(T&) {
   return 0;
 }
 
-template<typename Index> requires std::is_base_of_v<PatternMatcingIndex, Index>
-void benchmark_search(const Index& index, const Strings& positive, const Strings& negative, ResultCsvWriter& writer){
+template <typename, typename = std::void_t<>>
+struct has_search_batch : std::false_type {};
+template <typename T>
+struct has_search_batch<T, std::void_t<decltype(std::declval<T>().search_batch(std::declval<std::span<const StringView>>(), std::declval<std::span<bool>>()))>> : std::true_type {};
+
+template<PatternMatchingIndex Index>
+void benchmark_search_batch(const Index& index, const StringViews& positive, const StringViews& negative, ResultCsvWriter& writer){
+  auto positive_results = std::make_unique<bool[]>(positive.size());
+  auto negative_results = std::make_unique<bool[]>(negative.size());
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  index.search_batch(positive, std::span<bool>(positive_results.get(), positive.size()));
+  index.search_batch(negative, std::span<bool>(negative_results.get(), negative.size()));
+  std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+  std::size_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  std::size_t found = std::count(positive_results.get(), positive_results.get() + positive.size(), true)
+                      + std::count(negative_results.get(), negative_results.get() + negative.size(), true);
+  if(found != positive.size()){
+    std::clog << "error: " << found << " patterns are found by search_batch (expected " << positive.size() << ")" << std::endl;
+  }
+  std::string method = type_name<Index>();
+  method += "(batch)";
+  std::clog << "Type: " << method << std::endl;
+  std::clog << "Time: " << nanoseconds / 1e9 << " seconds." << std::endl;
+  std::size_t memory_usage = call_memory_usage(index);
+  std::clog << std::endl;
+  std::size_t queries = positive.size() + negative.size();
+  double qps = nanoseconds == 0 ? 0.0 : queries * 1e9 / nanoseconds;
+  writer.write({.method = method, .time_nanoseconds = nanoseconds, .memory_bytes = memory_usage, .queries = queries,
+                .mean_thread_queries_per_second = qps, .min_thread_queries_per_second = qps});
+}
+
+// splits the queries over the threads, each thread searches its share of both positive and negative patterns
+template<PatternMatchingIndex Index>
+void benchmark_search_parallel(const Index& index, const StringViews& positive, const StringViews& negative, unsigned int num_threads, ResultCsvWriter& writer){
+  std::vector<std::size_t> found(num_threads, 0), thread_nanoseconds(num_threads, 0);
+  std::barrier sync(num_threads + 1);
+  std::vector<std::thread> threads;
+  for(unsigned int t = 0; t < num_threads; ++t){
+    threads.emplace_back([&, t](){
+      std::size_t positive_begin = positive.size() * t / num_threads, positive_end = positive.size() * (t + 1) / num_threads;
+      std::size_t negative_begin = negative.size() * t / num_threads, negative_end = negative.size() * (t + 1) / num_threads;
+      sync.arrive_and_wait();
+      std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+      std::size_t cnt = 0;
+      for(std::size_t i = positive_begin; i < positive_end; ++i){
+        cnt += index.search(positive[i]);
+      }
+      for(std::size_t i = negative_begin; i < negative_end; ++i){
+        cnt += index.search(negative[i]);
+      }
+      std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+      found[t] = cnt;
+      thread_nanoseconds[t] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    });
+    if(!pin_thread_to_core(threads.back(), t)){
+      std::clog << "warning: failed to pin thread " << t << std::endl;
+    }
+  }
+  sync.arrive_and_wait();
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  for(auto& thread : threads){
+    thread.join();
+  }
+  std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+  std::size_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  std::size_t total_found = std::accumulate(found.begin(), found.end(), std::size_t(0));
+  if(total_found != positive.size()){
+    std::clog << "error: " << total_found << " patterns are found by " << num_threads << " threads (expected " << positive.size() << ")" << std::endl;
+  }
+  double mean_qps = 0, min_qps = std::numeric_limits<double>::max();
+  for(unsigned int t = 0; t < num_threads; ++t){
+    std::size_t queries = positive.size() * (t + 1) / num_threads - positive.size() * t / num_threads
+                          + negative.size() * (t + 1) / num_threads - negative.size() * t / num_threads;
+    double qps = thread_nanoseconds[t] == 0 ? 0.0 : queries * 1e9 / thread_nanoseconds[t];
+    mean_qps += qps / num_threads;
+    min_qps = std::min(min_qps, qps);
+  }
+  std::string method = type_name<Index>();
+  std::size_t queries = positive.size() + negative.size();
+  std::clog << "Type: " << method << " (" << num_threads << " threads)" << std::endl;
+  std::clog << "Time: " << nanoseconds / 1e9 << " seconds, " << queries * 1e9 / nanoseconds << " queries/sec." << std::endl;
+  std::clog << std::endl;
+  writer.write({.method = method, .time_nanoseconds = nanoseconds, .memory_bytes = call_memory_usage(index), .threads = num_threads,
+                .queries = queries, .mean_thread_queries_per_second = mean_qps, .min_thread_queries_per_second = min_qps});
+}
+
+template<PatternMatchingIndex Index>
+void benchmark_search_single(const Index& index, const StringViews& positive, const StringViews& negative, ResultCsvWriter& writer, const std::string& method_suffix = ""){
+  // the counters are opened before the timed region, so that they do not add to the time
+  std::optional<PerfCounters> counters;
+  if(benchmark_config.perf){
+    counters.emplace();
+  }
   // compute time
+  std::size_t found = 0;
+  if(counters){
+    counters->start();
+  }
   std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
   for(auto& pattern : positive){
     bool res = index.search(pattern);
     assert(res);
+    found += res;
   }
   for(auto& pattern : negative){
     bool res = index.search(pattern);
     assert(!res);
+    found += res;
   }
   std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+  if(counters){
+    counters->stop();
+  }
+  // the count keeps the lookups alive when assertions are disabled
+  if(found != positive.size()){
+    std::clog << "error: " << found << " patterns are found (expected " << positive.size() << ")" << std::endl;
+  }
   // nanoseconds
   std::size_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
   // output type of Index
-  std::string method = abi::__cxa_demangle(typeid(index).name(), 0, 0, nullptr);
+  std::string method = type_name<Index>();
+  method += method_suffix;
   std::clog << "Type: " << method << std::endl;
   std::clog << "Time: " << nanoseconds / 1e9 << " seconds." << std::endl;
   std::size_t memory_usage = call_memory_usage(index);
+  std::size_t queries = positive.size() + negative.size();
+  double qps = nanoseconds == 0 ? 0.0 : queries * 1e9 / nanoseconds;
+  PerfSummary perf = counters ? counters->summarize(queries) : PerfSummary();
+  if(counters && counters->available()){
+    std::clog << "Per query:";
+    for(std::size_t i = 0; i < NUM_PERF_EVENTS; ++i){
+      std::clog << " " << PERF_EVENT_NAMES[i] << " " << perf.per_query[i];
+    }
+    std::clog << std::endl;
+  }
+  std::clog << std::endl;
+  writer.write({.method = method, .time_nanoseconds = nanoseconds, .memory_bytes = memory_usage, .queries = queries,
+                .mean_thread_queries_per_second = qps, .min_thread_queries_per_second = qps, .perf = perf});
+}
+
+// times every query on its own: warmup passes over all queries, then `repeats` timed passes,
+// each recording the latencies of the positive and the negative queries into histograms of its own
+template<PatternMatchingIndex Index>
+void benchmark_search_latency(const Index& index, const StringViews& positive, const StringViews& negative, ResultCsvWriter& writer){
+  std::size_t mismatches = 0;
+  auto run = [&](const StringViews& patterns, bool expected, LatencyHistogram* histogram){
+    for(StringView pattern : patterns){
+      std::uint64_t start = read_timestamp();
+      bool res = index.search(pattern);
+      std::uint64_t end = read_timestamp();
+      mismatches += res != expected;
+      if(histogram != nullptr){
+        histogram->record(end - start);
+      }
+    }
+  };
+  for(std::size_t i = 0; i < benchmark_config.warmup; ++i){
+    run(positive, true, nullptr);
+    run(negative, false, nullptr);
+  }
+  std::vector<LatencyHistogram> positive_histograms(benchmark_config.repeats), negative_histograms(benchmark_config.repeats);
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  for(std::size_t i = 0; i < benchmark_config.repeats; ++i){
+    run(positive, true, &positive_histograms[i]);
+    run(negative, false, &negative_histograms[i]);
+  }
+  std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+  if(mismatches != 0){
+    std::clog << "error: " << mismatches << " patterns are answered wrongly" << std::endl;
+  }
+  // the time of one repeat, including the timestamp reads
+  std::size_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / benchmark_config.repeats;
+  std::string method = type_name<Index>();
+  LatencySummary positive_latency = summarize_latency(positive_histograms);
+  LatencySummary negative_latency = summarize_latency(negative_histograms);
+  std::clog << "Type: " << method << "(latency)" << std::endl;
+  for(auto [kind, latency] : {std::make_pair("positive", &positive_latency), std::make_pair("negative", &negative_latency)}){
+    std::clog << "Latency " << kind << ":";
+    for(std::size_t k = 0; k < LATENCY_QUANTILES.size(); ++k){
+      std::clog << " " << LATENCY_QUANTILE_NAMES[k] << " " << latency->quantiles[k] << "ns (var " << latency->variances[k] << ")";
+    }
+    std::clog << std::endl;
+  }
+  std::clog << std::endl;
+  std::size_t queries = positive.size() + negative.size();
+  double qps = nanoseconds == 0 ? 0.0 : queries * 1e9 / nanoseconds;
+  writer.write({.method = method + "(latency)", .time_nanoseconds = nanoseconds, .memory_bytes = call_memory_usage(index), .queries = queries,
+                .mean_thread_queries_per_second = qps, .min_thread_queries_per_second = qps,
+                .positive_latency = positive_latency, .negative_latency = negative_latency});
+}
+
+template <typename, typename = std::void_t<>>
+struct has_predictive_search : std::false_type {};
+template <typename T>
+struct has_predictive_search<T, std::void_t<decltype(std::declval<T>().predictive_search(std::declval<StringView>(), std::declval<void(*)(const String&)>()))>> : std::true_type {};
+
+// enumerates the keys below every prefix of predictive_workload; the queries of the row are the reported keys
+template<PatternMatchingIndex Index>
+void benchmark_predictive_search(const Index& index, ResultCsvWriter& writer){
+  std::size_t keys = 0, total_length = 0;
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  for(auto& prefix : predictive_workload.prefixes){
+    index.predictive_search(prefix, [&](const String& key){
+      ++keys;
+      total_length += key.size();
+    });
+  }
+  std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+  std::size_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  if(keys != predictive_workload.expected_keys){
+    std::clog << "error: " << keys << " keys are enumerated (expected " << predictive_workload.expected_keys << ")" << std::endl;
+  }
+  // the keys below a prefix have to come in strictly ascending order
+  for(auto& prefix : predictive_workload.prefixes){
+    String prev;
+    bool sorted = true;
+    index.predictive_search(prefix, [&](const String& key){
+      sorted &= prev < key;
+      prev = key;
+    });
+    if(!sorted){
+      std::clog << "error: predictive_search does not enumerate in lexicographic order" << std::endl;
+      break;
+    }
+  }
+  std::string method = type_name<Index>();
+  method += "(predictive)";
+  std::clog << "Type: " << method << std::endl;
+  std::clog << "Time: " << nanoseconds / 1e9 << " seconds, " << keys << " keys, " << keys * 1e9 / nanoseconds << " keys/sec." << std::endl;
+  std::clog << std::endl;
+  double keys_per_second = nanoseconds == 0 ? 0.0 : keys * 1e9 / nanoseconds;
+  writer.write({.method = method, .time_nanoseconds = nanoseconds, .memory_bytes = call_memory_usage(index), .queries = keys,
+                .mean_thread_queries_per_second = keys_per_second, .min_thread_queries_per_second = keys_per_second});
+}
+
+template <typename, typename = std::void_t<>>
+struct has_lookup : std::false_type {};
+template <typename T>
+struct has_lookup<T, std::void_t<decltype(std::declval<T>().lookup(std::declval<StringView>())), decltype(std::declval<T>().access(0))>> : std::true_type {};
+
+// key -> rank over the positive and negative patterns, then rank -> key over the ranks of the positive ones
+template<PatternMatchingIndex Index>
+void benchmark_lookup_access(const Index& index, const StringViews& positive, const StringViews& negative, ResultCsvWriter& writer){
+  std::string method = type_name<Index>();
+  std::size_t memory_usage = call_memory_usage(index);
+  std::vector<::Index> ids(positive.size());
+  std::size_t not_found = 0;
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  for(std::size_t i = 0; i < positive.size(); ++i){
+    ids[i] = index.lookup(positive[i]);
+  }
+  for(auto& pattern : negative){
+    not_found += index.lookup(pattern) == NOT_FOUND;
+  }
+  std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+  std::size_t lookup_nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  // the ranks of the keys have to be in 0, ..., size() - 1
+  // (distinct ranks for distinct keys follow from the access check below)
+  bool out_of_range = std::any_of(ids.begin(), ids.end(), [&](::Index id){
+    return id < 0 || id >= static_cast<::Index>(index.size());
+  });
+  if(not_found != negative.size() || out_of_range){
+    std::clog << "error: lookup does not map the " << index.size() << " keys into [0, " << index.size() << ")" << std::endl;
+  }
+  std::size_t mismatches = 0;
+  start = std::chrono::high_resolution_clock::now();
+  for(std::size_t i = 0; i < positive.size(); ++i){
+    mismatches += !std::ranges::equal(index.access(ids[i]), positive[i]);
+  }
+  end = std::chrono::high_resolution_clock::now();
+  std::size_t access_nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  if(mismatches != 0){
+    std::clog << "error: access(lookup(key)) differs from key for " << mismatches << " keys" << std::endl;
+  }
+  std::clog << "Type: " << method << "(lookup)" << std::endl;
+  std::clog << "Time: " << lookup_nanoseconds / 1e9 << " seconds." << std::endl;
+  std::clog << "Type: " << method << "(access)" << std::endl;
+  std::clog << "Time: " << access_nanoseconds / 1e9 << " seconds." << std::endl;
   std::clog << std::endl;
-  writer.write(method, nanoseconds, memory_usage);
+  std::size_t lookups = positive.size() + negative.size();
+  double lookup_qps = lookup_nanoseconds == 0 ? 0.0 : lookups * 1e9 / lookup_nanoseconds;
+  double access_qps = access_nanoseconds == 0 ? 0.0 : positive.size() * 1e9 / access_nanoseconds;
+  writer.write({.method = method + "(lookup)", .time_nanoseconds = lookup_nanoseconds, .memory_bytes = memory_usage, .queries = lookups,
+                .mean_thread_queries_per_second = lookup_qps, .min_thread_queries_per_second = lookup_qps});
+  writer.write({.method = method + "(access)", .time_nanoseconds = access_nanoseconds, .memory_bytes = memory_usage, .queries = positive.size(),
+                .mean_thread_queries_per_second = access_qps, .min_thread_queries_per_second = access_qps});
+}
+
+template <typename, typename = std::void_t<>>
+struct has_common_prefix_search : std::false_type {};
+template <typename T>
+struct has_common_prefix_search<T, std::void_t<decltype(std::declval<T>().common_prefix_search(std::declval<std::span<const Char>>(), 0, std::declval<void(*)(std::size_t)>()))>> : std::true_type {};
+
+// finds the keys that start at every position of the corpus (or of scan_sample); the queries of the row are the positions
+template<PatternMatchingIndex Index>
+void benchmark_common_prefix_search(const Index& index, unsigned int num_threads, ResultCsvWriter& writer){
+  struct alignas(64) Counter{
+    std::size_t matches = 0;
+  };
+  std::vector<Counter> counters(num_threads);
+  auto count = [&](unsigned int t, std::size_t, std::size_t){
+    ++counters[t].matches;
+  };
+  std::size_t positions;
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  if(benchmark_config.corpus.empty()){
+    scan_text(index, scan_sample, num_threads, count);
+    positions = scan_sample.size();
+  }
+  else{
+    scan_corpus(index, benchmark_config.corpus, num_threads, count);
+    positions = std::filesystem::file_size(benchmark_config.corpus);
+  }
+  std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+  std::size_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  std::size_t matches = 0;
+  for(auto& counter : counters){
+    matches += counter.matches;
+  }
+  // every reported match has to be a key, and every key starting in the first positions has to be reported
+  if(benchmark_config.corpus.empty() && num_threads == 1){
+    std::size_t checked_positions = std::min<std::size_t>(scan_sample.size(), 1000), mismatches = 0;
+    // the patterns are at most a line and an EOW, padded for the word-wise reads of get_lcp past their end
+    PaddedString pattern;
+    pattern.reserve(scan_sample.size() + 1);
+    for(std::size_t pos = 0; pos < checked_positions; ++pos){
+      std::vector<std::size_t> lens;
+      index.common_prefix_search(scan_sample, pos, [&](std::size_t len){
+        lens.emplace_back(len);
+      });
+      std::vector<std::size_t> expected;
+      for(std::size_t len = 0; pos + len <= scan_sample.size(); ++len){
+        pattern.clear();
+        pattern.append(StringView(scan_sample).subspan(pos, len));
+        pattern.emplace_back(EOW);
+        if(index.search(pattern)){
+          expected.emplace_back(len);
+        }
+        if(pos + len < scan_sample.size() && scan_sample[pos + len] == '\n'){
+          break;
+        }
+      }
+      mismatches += lens != expected;
+    }
+    if(mismatches != 0){
+      std::clog << "error: common_prefix_search differs from search at " << mismatches << " positions" << std::endl;
+    }
+  }
+  std::string method = type_name<Index>();
+  method += "(common prefix)";
+  std::clog << "Type: " << method << " (" << num_threads << " threads)" << std::endl;
+  std::clog << "Time: " << nanoseconds / 1e9 << " seconds, " << matches << " matches in " << positions << " positions." << std::endl;
+  std::clog << std::endl;
+  // the threads are not timed individually, so the per-thread columns are only filled for a single thread
+  double positions_per_second = nanoseconds == 0 || num_threads > 1 ? 0.0 : positions * 1e9 / nanoseconds;
+  writer.write({.method = method, .time_nanoseconds = nanoseconds, .memory_bytes = call_memory_usage(index), .threads = num_threads,
+                .queries = positions, .mean_thread_queries_per_second = positions_per_second, .min_thread_queries_per_second = positions_per_second});
+}
+
+template <typename, typename = std::void_t<>>
+struct has_save : std::false_type {};
+template <typename T>
+struct has_save<T, std::void_t<decltype(std::declval<T>().save(std::declval<std::string>()))>> : std::true_type {};
+
+// writes the index to the on-disk format, maps it back and searches on the mapped copy
+template<PatternMatchingIndex Index>
+void benchmark_mmap(const Index& index, const StringViews& positive, const StringViews& negative, ResultCsvWriter& writer){
+  std::string method = type_name<Index>();
+  std::string file_name = method;
+  std::replace_if(file_name.begin(), file_name.end(), [](char c){ return !std::isalnum(c); }, '_');
+  std::string path = (std::filesystem::path(benchmark_config.mmap_dir) / (file_name + ".idx")).string();
+  index.save(path);
+  std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+  Index mapped = Index::open_mmap(path);
+  std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+  std::clog << "Saved to \"" << path << "\" (" << std::filesystem::file_size(path) / 1024.0 << "[KiB]), opened in "
+            << std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / 1e6 << " milliseconds." << std::endl;
+  benchmark_search_single(mapped, positive, negative, writer, "(mmap)");
+}
+
+template<PatternMatchingIndex Index>
+void benchmark_search(const Index& index, const StringViews& positive, const StringViews& negative, ResultCsvWriter& writer){
+  benchmark_search_single(index, positive, negative, writer);
+  if(benchmark_config.repeats > 0){
+    benchmark_search_latency(index, positive, negative, writer);
+  }
+  if constexpr(has_search_batch<Index>::value){
+    benchmark_search_batch(index, positive, negative, writer);
+  }
+  if constexpr(has_predictive_search<Index>::value){
+    benchmark_predictive_search(index, writer);
+  }
+  if constexpr(has_lookup<Index>::value){
+    benchmark_lookup_access(index, positive, negative, writer);
+  }
+  if constexpr(has_common_prefix_search<Index>::value){
+    benchmark_common_prefix_search(index, 1, writer);
+    for(auto num_threads : benchmark_config.threads){
+      benchmark_common_prefix_search(index, num_threads, writer);
+    }
+  }
+  for(auto num_threads : benchmark_config.threads){
+    benchmark_search_parallel(index, positive, negative, num_threads, writer);
+  }
+  if constexpr(has_save<Index>::value){
+    if(!benchmark_config.mmap_dir.empty()){
+      benchmark_mmap(index, positive, negative, writer);
+    }
+  }
+}
+
+// times the construction of an index and records it as a row of its own,
+// together with its memory and the peak RSS of the construction in build_metrics.csv
+template<typename F>
+auto benchmark_construction(const std::string& method, ResultCsvWriter& writer, F&& build){
+  StageMeter meter;
+  auto index = build();
+  StageMetrics metrics = meter.finish();
+  std::size_t memory = 0;
+  if constexpr(has_memory_usage<decltype(index)>::value){
+    memory = index.memory_usage();
+  }
+  std::clog << "Construction of " << method << ": " << metrics.time_nanoseconds / 1e9 << " seconds, peak RSS "
+            << metrics.peak_rss_bytes / 1048576.0 << "[MiB] (" << metrics.rss_before_bytes / 1048576.0 << "[MiB] before)" << std::endl;
+  writer.write({.method = method + "(construction)", .time_nanoseconds = metrics.time_nanoseconds, .memory_bytes = memory});
+  build_metrics_writer->write(method, metrics, memory);
+  return index;
+}
+
+// compares the double-array placement engines and the byte/dense label codes on the same edge lists.
+// The transitions row times a lookup of every edge from the base of its source.
+void benchmark_placement(const std::string& name, std::vector<std::vector<std::pair<Char, Index>>>& data, bool with_reindexing, ResultCsvWriter& writer){
+  std::size_t edges = 0;
+  for(auto& vec : data){
+    edges += vec.size();
+  }
+  for(auto [placement, placement_name] : {std::make_pair(DoubleArrayPlacement::Linear, "Linear"), std::make_pair(DoubleArrayPlacement::FreeList, "FreeList")}){
+    for(bool dense_alphabet : {false, true}){
+      StageMeter meter;
+      auto [maps, cor] = with_reindexing ? DoubleArrayMaps<>::construct_with_reindexing(data, placement, dense_alphabet)
+                                         : DoubleArrayMaps<>::construct_without_reindexing(data, placement, dense_alphabet);
+      StageMetrics metrics = meter.finish();
+      std::size_t nanoseconds = metrics.time_nanoseconds;
+      std::string method = "DoubleArrayMaps:" + name + ":" + placement_name + (dense_alphabet ? ":dense" : ":bytes");
+      std::size_t memory = maps.memory_usage();
+      std::clog << "Construction of " << method << ": " << nanoseconds / 1e9 << " seconds, "
+                << maps.size() << " cells, " << maps.alphabet_size() << " codes, fill rate " << maps.fill_rate() << std::endl;
+      writer.write({.method = method + "(construction)", .time_nanoseconds = nanoseconds, .memory_bytes = memory, .fill_rate = maps.fill_rate()});
+      build_metrics_writer->write(method, metrics, memory);
+
+      std::size_t found = 0;
+      auto start = std::chrono::high_resolution_clock::now();
+      for(Index i = 0; i < data.size(); ++i){
+        for(auto [key, to] : data[i]){
+          found += maps.search(cor[i], key) != NOT_FOUND;
+        }
+      }
+      auto end = std::chrono::high_resolution_clock::now();
+      nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+      if(found != edges){
+        std::clog << "error: " << found << " edges are found by " << method << " (expected " << edges << ")" << std::endl;
+      }
+      std::clog << "Transitions of " << method << ": " << nanoseconds / 1e9 << " seconds" << std::endl;
+      double qps = nanoseconds == 0 ? 0.0 : edges * 1e9 / nanoseconds;
+      writer.write({.method = method + "(transitions)", .time_nanoseconds = nanoseconds, .memory_bytes = memory, .queries = edges,
+                    .mean_thread_queries_per_second = qps, .min_thread_queries_per_second = qps, .fill_rate = maps.fill_rate()});
+    }
+  }
+  std::clog << std::endl;
+}
+
+// builds a double-array index with the given cell layout, skipping layouts that cannot hold the index
+template<template<typename> typename DoubleArrayIndex, typename Cells, typename Base>
+void benchmark_cell_layout(const Base& base, const StringViews& positive, const StringViews& negative, ResultCsvWriter& writer){
+  try{
+    auto index = benchmark_construction(type_name<DoubleArrayIndex<Cells>>(), writer, [&](){
+      return DoubleArrayIndex<Cells>(base);
+    });
+    benchmark_search(index, positive, negative, writer);
+  }
+  catch(const std::overflow_error& e){
+    std::clog << "Skipped " << Cells::name << " cells: " << e.what() << std::endl << std::endl;
+  }
+}
+
+// builds an index with a non-default IndexLayout, skipping layouts that cannot hold the index
+template<typename LayoutIndex, typename Base>
+void benchmark_index_layout(const Base& base, const StringViews& positive, const StringViews& negative, ResultCsvWriter& writer){
+  try{
+    auto index = benchmark_construction(type_name<LayoutIndex>(), writer, [&](){
+      return LayoutIndex(base);
+    });
+    benchmark_search(index, positive, negative, writer);
+  }
+  catch(const std::overflow_error& e){
+    std::clog << "Skipped " << type_name<LayoutIndex>() << ": " << e.what() << std::endl << std::endl;
+  }
+}
+
+template<typename BinarySearchIndex, typename Base>
+void benchmark_edge_store(const Base& base, const StringViews& positive, const StringViews& negative, ResultCsvWriter& writer){
+  auto index = benchmark_construction(type_name<BinarySearchIndex>(), writer, [&](){
+    return BinarySearchIndex(base);
+  });
+  benchmark_search(index, positive, negative, writer);
+}
+
+// builds a binary-search index with every combination of edge store and offset directory
+template<template<typename, typename> typename BinarySearchIndex, typename Base>
+void benchmark_edge_stores(const Base& base, const StringViews& positive, const StringViews& negative, ResultCsvWriter& writer){
+  benchmark_edge_store<BinarySearchIndex<SortedEdges, SelectDirectory>>(base, positive, negative, writer);
+  benchmark_edge_store<BinarySearchIndex<SimdEdges, SelectDirectory>>(base, positive, negative, writer);
+  benchmark_edge_store<BinarySearchIndex<SortedEdges, PrefixSumDirectory>>(base, positive, negative, writer);
+  benchmark_edge_store<BinarySearchIndex<SimdEdges, PrefixSumDirectory>>(base, positive, negative, writer);
+}
+
+template<template<typename> typename DoubleArrayIndex, typename Base>
+void benchmark_cell_layouts(const Base& base, const StringViews& positive, const StringViews& negative, ResultCsvWriter& writer){
+  benchmark_cell_layout<DoubleArrayIndex, SplitCells>(base, positive, negative, writer);
+  benchmark_cell_layout<DoubleArrayIndex, PackedCells>(base, positive, negative, writer);
+  benchmark_cell_layout<DoubleArrayIndex, InterleavedCells>(base, positive, negative, writer);
+  benchmark_cell_layout<DoubleArrayIndex, BitPackedCells>(base, positive, negative, writer);
+}
+
+// builds a DynamicADFA from the keys, inserts the unseen keys and erases them again. After each phase the key set is checked
+// and the number of states is compared with the minimal ADFA of the same keys built from scratch.
+template<typename Static>
+void benchmark_dynamic(const StringViews& keys, const StringViews& unseen, ResultCsvWriter& writer){
+  std::string method = type_name<DynamicADFA<Static>>();
+  StageMeter meter;
+  DynamicADFA<Static> dynamic(keys);
+  StageMetrics metrics = meter.finish();
+  std::size_t memory = dynamic.memory_usage();
+  std::clog << "Construction of " << method << ": " << metrics.time_nanoseconds / 1e9 << " seconds" << std::endl;
+  writer.write({.method = method + "(construction)", .time_nanoseconds = metrics.time_nanoseconds, .memory_bytes = memory});
+  build_metrics_writer->write(method, metrics, memory);
+  Index initial_states = dynamic.num_states();
+
+  auto check = [&](const DynamicADFA<Static>& checked, const char* phase, bool unseen_present, Index expected_states){
+    std::size_t wrong = 0;
+    for(auto key : keys){
+      wrong += !checked.search(key);
+    }
+    for(auto key : unseen){
+      wrong += checked.search(key) != unseen_present;
+    }
+    if(wrong != 0){
+      std::clog << "error: " << wrong << " keys are misreported by " << method << " after " << phase << std::endl;
+    }
+    if(checked.num_states() != expected_states){
+      std::clog << "error: " << method << " has " << checked.num_states() << " states after " << phase
+                << " (the minimal ADFA has " << expected_states << ")" << std::endl;
+    }
+  };
+  auto update = [&](const char* phase, bool insert){
+    std::size_t changed = 0;
+    auto start = std::chrono::high_resolution_clock::now();
+    for(auto key : unseen){
+      changed += insert ? dynamic.insert(key) : dynamic.erase(key);
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::size_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    if(changed != unseen.size()){
+      std::clog << "error: " << changed << " keys are changed by " << phase << " (expected " << unseen.size() << ")" << std::endl;
+    }
+    std::clog << "Type: " << method << "(" << phase << ")" << std::endl;
+    std::clog << "Time: " << nanoseconds / 1e9 << " seconds, " << dynamic.num_merges() << " merges so far, delta of " << dynamic.delta_size() << " keys." << std::endl;
+    double qps = nanoseconds == 0 ? 0.0 : unseen.size() * 1e9 / nanoseconds;
+    writer.write({.method = method + "(" + phase + ")", .time_nanoseconds = nanoseconds, .memory_bytes = dynamic.memory_usage(), .queries = unseen.size(),
+                  .mean_thread_queries_per_second = qps, .min_thread_queries_per_second = qps});
+  };
+
+  update("insert", true);
+  dynamic.merge();
+  StringViews all_keys = keys;
+  all_keys.insert(all_keys.end(), unseen.begin(), unseen.end());
+  std::sort(all_keys.begin(), all_keys.end(), view_less);
+  check(dynamic, "insert", true, BaseADFA::construct_from_sorted(all_keys).to_vector().size());
+  update("erase", false);
+  dynamic.merge();
+  check(dynamic, "erase", false, initial_states);
+
+  // writers that start merges of their own (small threshold) race with explicit merges from this thread, while readers
+  // check every snapshot they get: each writer changes its share of the held-out keys in order, so the changed keys of a share
+  // are a prefix of it, and a later snapshot of the same reader has at least as many changed keys
+  DynamicADFA<Static> stressed(keys, 64);
+  auto stress = [&](const char* phase, bool insert){
+    unsigned int num_threads = std::clamp(std::thread::hardware_concurrency(), 2u, 8u);
+    std::atomic<std::size_t> changed = 0;
+    std::atomic<unsigned int> running = num_threads;
+    std::size_t explicit_merges = 0;
+    std::atomic<std::size_t> snapshots = 0, inconsistent = 0;
+    std::vector<std::thread> threads, readers;
+    for(unsigned int r = 0; r < 2; ++r){
+      readers.emplace_back([&, r](){
+        std::size_t last_changed = 0;
+        for(std::size_t round = 0; running != 0; ++round){
+          auto snapshot = stressed.current();
+          bool consistent = true;
+          std::size_t total_changed = 0;
+          for(unsigned int t = 0; t < num_threads; ++t){
+            std::size_t begin = unseen.size() * t / num_threads, end = unseen.size() * (t + 1) / num_threads;
+            std::size_t i = begin;
+            for(; i < end && snapshot->search(unseen[i]) == insert; ++i);
+            total_changed += i - begin;
+            for(; i < end; ++i){
+              consistent &= snapshot->search(unseen[i]) != insert;
+            }
+          }
+          // a sample of the keys, which no writer touches, through the latest snapshot
+          for(std::size_t i = (round + r) % 64; i < keys.size(); i += 64){
+            consistent &= stressed.search(keys[i]);
+          }
+          consistent &= total_changed >= last_changed;
+          last_changed = total_changed;
+          ++snapshots;
+          inconsistent += !consistent;
+        }
+      });
+    }
+    for(unsigned int t = 0; t < num_threads; ++t){
+      threads.emplace_back([&, t](){
+        std::size_t begin = unseen.size() * t / num_threads, end = unseen.size() * (t + 1) / num_threads;
+        std::size_t cnt = 0;
+        for(std::size_t i = begin; i < end; ++i){
+          cnt += insert ? stressed.insert(unseen[i]) : stressed.erase(unseen[i]);
+        }
+        changed += cnt;
+        --running;
+      });
+    }
+    while(running != 0){
+      stressed.merge();
+      ++explicit_merges;
+    }
+    for(auto& thread : threads){
+      thread.join();
+    }
+    for(auto& reader : readers){
+      reader.join();
+    }
+    stressed.merge();
+    if(inconsistent != 0){
+      std::clog << "error: " << inconsistent << " of " << snapshots << " snapshots of " << method << " are inconsistent during " << phase << std::endl;
+    }
+    if(changed != unseen.size()){
+      std::clog << "error: " << changed << " keys are changed by " << phase << " (expected " << unseen.size() << ")" << std::endl;
+    }
+    std::clog << "Stress: " << method << "(" << phase << "), " << num_threads << " writers, " << explicit_merges << " explicit merges, " << snapshots << " snapshots read, "
+              << stressed.num_merges() << " merges so far." << std::endl;
+  };
+  stress("concurrent insert", true);
+  check(stressed, "concurrent insert", true, BaseADFA::construct_from_sorted(all_keys).to_vector().size());
+  stress("concurrent erase", false);
+  check(stressed, "concurrent erase", false, initial_states);
+  std::clog << std::endl;
+}
+
+// parses a comma separated list such as "1,2,4,nproc"
+std::vector<unsigned int> parse_thread_counts(const std::string& arg){
+  std::vector<unsigned int> counts;
+  std::stringstream ss(arg);
+  std::string token;
+  while(std::getline(ss, token, ',')){
+    if(token == "nproc"){
+      counts.emplace_back(std::thread::hardware_concurrency());
+    }
+    else{
+      counts.emplace_back(std::stoul(token));
+    }
+    assert(counts.back() > 0);
+  }
+  return counts;
 }
 
 
 int main(int argc, char** argv){
 
-  if(argc == 1){
-    std::clog << "Usage: " << argv[0] << " [dataset_name] [dataset_size (optional)]" << std::endl;
+  std::vector<std::string> args;
+  for(int i = 1; i < argc; ++i){
+    std::string arg = argv[i];
+    if(arg == "--threads" && i + 1 < argc){
+      benchmark_config.threads = parse_thread_counts(argv[++i]);
+    }
+    else if(arg == "--corpus" && i + 1 < argc){
+      benchmark_config.corpus = argv[++i];
+    }
+    else if(arg == "--perf"){
+      benchmark_config.perf = true;
+    }
+    else if(arg == "--warmup" && i + 1 < argc){
+      benchmark_config.warmup = std::stoul(argv[++i]);
+    }
+    else if(arg == "--repeats" && i + 1 < argc){
+      benchmark_config.repeats = std::stoul(argv[++i]);
+    }
+    else if(arg == "--queries" && i + 1 < argc){
+      benchmark_config.workload.queries = std::stoul(argv[++i]);
+    }
+    else if(arg == "--negative-ratio" && i + 1 < argc){
+      benchmark_config.workload.negative_ratio = std::stod(argv[++i]);
+    }
+    else if(arg == "--zipf" && i + 1 < argc){
+      benchmark_config.workload.zipf_exponent = std::stod(argv[++i]);
+    }
+    else if(arg == "--perturbed" && i + 1 < argc){
+      benchmark_config.workload.perturbed = std::stod(argv[++i]);
+    }
+    else if(arg == "--perturb-position" && i + 1 < argc){
+      benchmark_config.workload.perturb_position = std::stoi(argv[++i]);
+    }
+    else if(arg == "--truncated" && i + 1 < argc){
+      benchmark_config.workload.truncated = std::stod(argv[++i]);
+    }
+    else if(arg == "--junk" && i + 1 < argc){
+      benchmark_config.workload.junk = std::stod(argv[++i]);
+    }
+    else if(arg == "--workload-seed" && i + 1 < argc){
+      benchmark_config.workload.seed = std::stoull(argv[++i]);
+    }
+    else if(arg == "--mmap-dir" && i + 1 < argc){
+      benchmark_config.mmap_dir = argv[++i];
+      std::filesystem::create_directories(benchmark_config.mmap_dir);
+    }
+    else{
+      args.emplace_back(arg);
+    }
+  }
+  if(args.empty()){
+    std::clog << "Usage: " << argv[0] << " [dataset_name] [dataset_size (optional)] [--threads 1,2,4,...,nproc (optional)] [--mmap-dir dir (optional)] [--corpus file (optional)] [--warmup n (optional)] [--repeats n (optional)] [--perf (optional)] [workload options (optional), see README.md]" << std::endl;
     return 0;
   }
-  std::string dataset_name = argv[1];
-  int dataset_size = 1e9;
-  if(argc >= 3){
-    dataset_size = std::stoi(argv[2]);
+  if(benchmark_config.perf && !PerfCounters().available()){
+    std::clog << "warning: no hardware events can be counted (check /proc/sys/kernel/perf_event_paranoid), the perf columns stay empty" << std::endl;
+  }
+  std::string dataset_name = args[0];
+  std::size_t dataset_size = 1e9;
+  if(args.size() >= 2){
+    dataset_size = std::stoull(args[1]);
   }
-  auto data = load_dataset(dataset_name, dataset_size);
-  auto [positive, negative] = split_data(data, 0.0);
+  // the keys and the queries point into data (and workload), which live until the end of main
+  StringPool data = load_dataset(dataset_name, dataset_size);
+  // the indexes store keys, unseen keys are negative queries
+  auto [keys, unseen] = split_data(data.keys(), 0.0);
+  QueryWorkload workload(keys, unseen, benchmark_config.workload);
+  const StringViews& positive = workload.positive();
+  const StringViews& negative = workload.negative();
 
   std::size_t total_length = 0;
-  for(auto& pattern : positive){
+  for(auto& pattern : keys){
     total_length += pattern.size();
   }
-  ResultCsvWriter writer(dataset_name, positive.size(), total_length);
+  ResultCsvWriter writer(dataset_name, keys.size(), total_length);
+  build_metrics_writer.emplace(dataset_name, keys.size(), total_length);
+  predictive_workload = make_predictive_workload(keys, 1000);
+  scan_sample = make_scan_sample(keys, 1 << 20);
 
-  BaseTrie trie(positive);
+  BaseTrie trie = benchmark_construction("BaseTrie", writer, [&](){
+    return BaseTrie(keys);
+  });
   trie.print_stats();
+  [&](){
+    auto data = trie.to_vector();
+    benchmark_placement("Trie", data, true, writer);
+  }();
   benchmark_search(trie, positive, negative, writer);
 
   [&](){
-    DoubleArrayTrie datrie(trie);
-    benchmark_search(datrie, positive, negative, writer);
+    benchmark_cell_layouts<DoubleArrayTrie>(trie, positive, negative, writer);
   }();
 
   [&](){
-    BinarySearchTrie bstrie(trie);
-    benchmark_search(bstrie, positive, negative, writer);
+    benchmark_edge_stores<BinarySearchTrie>(trie, positive, negative, writer);
   }();
 
   [&](){
-    TailTrie ttrie(trie);
+    TailTrie ttrie = benchmark_construction("TailTrie", writer, [&](){
+      return TailTrie(trie);
+    });
+    std::clog << "tail bytes: " << ttrie.tail_str.size() << " (" << ttrie.unshared_tail_size << " before suffix sharing)" << std::endl;
     benchmark_search(ttrie, positive, negative, writer);
     [&](){
-      TailDoubleArrayTrie tdatrie(ttrie);
-      benchmark_search(tdatrie, positive, negative, writer);
+      benchmark_cell_layouts<TailDoubleArrayTrie>(ttrie, positive, negative, writer);
     }();
     [&](){
-      TailBinarySearchTrie tbstrie(ttrie);
-      benchmark_search(tbstrie, positive, negative, writer);
+      benchmark_edge_stores<TailBinarySearchTrie>(ttrie, positive, negative, writer);
     }();
   }();
 
   [&](){
-    PathDecomposedTrie pdtrie(trie);
+    PathDecomposedTrie pdtrie = benchmark_construction("PathDecomposedTrie", writer, [&](){
+      return PathDecomposedTrie(trie);
+    });
     benchmark_search(pdtrie, positive, negative, writer);
     [&](){
-      PathDecomposedDoubleArrayTrie pddatrie(pdtrie);
-      benchmark_search(pddatrie, positive, negative, writer);
+      benchmark_cell_layouts<PathDecomposedDoubleArrayTrie>(pdtrie, positive, negative, writer);
     }();
     [&](){
-      PathDecomposedBinarySearchTrie pdbstrie(pdtrie);
-      benchmark_search(pdbstrie, positive, negative, writer);
+      benchmark_edge_stores<PathDecomposedBinarySearchTrie>(pdtrie, positive, negative, writer);
     }();
   }();
 
   [&](){
-    BaseADFA adfa(trie);
+    StringViews sorted_keys = keys;
+    std::sort(sorted_keys.begin(), sorted_keys.end(), view_less);
+    BaseADFA adfa = benchmark_construction("BaseADFA:sorted", writer, [&](){
+      return BaseADFA::construct_from_sorted(sorted_keys);
+    });
+    BaseADFA adfa_from_trie = benchmark_construction("BaseADFA:trie", writer, [&](){
+      return BaseADFA(trie);
+    });
+    if(canonical_edges(adfa_from_trie) != canonical_edges(adfa)){
+      std::clog << "error: BaseADFA:trie differs from BaseADFA:sorted" << std::endl;
+    }
     adfa.print_stats();
+    [&](){
+      auto data = adfa.to_vector();
+      benchmark_placement("ADFA", data, true, writer);
+    }();
     benchmark_search(adfa, positive, negative, writer);
     [&]() {
-      DoubleArrayADFA daadfa(adfa);
-      benchmark_search(daadfa, positive, negative, writer);
+      benchmark_cell_layouts<DoubleArrayADFA>(adfa, positive, negative, writer);
+      // CompactDoubleArrayADFA
+      benchmark_cell_layout<DoubleArrayADFA, XorCells>(adfa, positive, negative, writer);
+      // the labels as their own codes, without the code table
+      benchmark_index_layout<DoubleArrayADFA<SplitCells, ByteCodeLayout>>(adfa, positive, negative, writer);
     }();
     [&]() {
-      BinarySearchADFA bsadfa(adfa);
-      benchmark_search(bsadfa, positive, negative, writer);
+      benchmark_edge_stores<BinarySearchADFA>(adfa, positive, negative, writer);
     }();
     [&]() {
-      PathDecomposedADFA pdadfa(adfa);
+      auto index = benchmark_construction("AdaptiveADFA", writer, [&](){
+        return AdaptiveADFA(adfa);
+      });
+      index.print_stats();
+      benchmark_search(index, positive, negative, writer);
+    }();
+    [&]() {
+      PathDecomposedADFA pdadfa = benchmark_construction("PathDecomposedADFA", writer, [&](){
+        return PathDecomposedADFA(adfa);
+      });
+      [&](){
+        auto light_edges = pdadfa.maps.to_vector();
+        benchmark_placement("PathDecomposedADFA", light_edges, false, writer);
+      }();
       benchmark_search(pdadfa, positive, negative, writer);
       [&]() {
-        PathDecomposedDoubleArrayADFA pddaadfa(pdadfa);
-        benchmark_search(pddaadfa, positive, negative, writer);
+        benchmark_cell_layouts<PathDecomposedDoubleArrayADFA>(pdadfa, positive, negative, writer);
+        // CompactPathDecomposedDoubleArrayADFA
+        benchmark_cell_layout<PathDecomposedDoubleArrayADFA, XorCells>(pdadfa, positive, negative, writer);
+        benchmark_index_layout<PathDecomposedDoubleArrayADFA<SplitCells, ByteCodeLayout>>(pdadfa, positive, negative, writer);
+        if constexpr(INDEX_BITS > 32){
+          // the bases of the light edges in 32 bits
+          benchmark_index_layout<PathDecomposedDoubleArrayADFA<SplitCells, IndexLayout<MAX_DENSE_LABELS, 32>>>(pdadfa, positive, negative, writer);
+        }
       }();
       [&]() {
-        PathDecomposedBinarySearchADFA pdbsadfa(pdadfa);
-        benchmark_search(pdbsadfa, positive, negative, writer);
+        benchmark_edge_stores<PathDecomposedBinarySearchADFA>(pdadfa, positive, negative, writer);
+      }();
+      [&]() {
+        auto index = benchmark_construction("PathDecomposedAdaptiveADFA", writer, [&](){
+          return PathDecomposedAdaptiveADFA(pdadfa);
+        });
+        index.print_stats();
+        benchmark_search(index, positive, negative, writer);
       }();
     }();
   }();
 
+  [&](){
+    benchmark_dynamic<DoubleArrayADFA<>>(keys, unseen, writer);
+    benchmark_dynamic<PathDecomposedDoubleArrayADFA<>>(keys, unseen, writer);
+  }();
+
   return 0;
 }
@@ -0,0 +1,305 @@
+//
+// Created by shibh308 on 2026/10/16.
+//
+
+#ifndef PACKED_ADFA_MMAP_IO_HPP
+#define PACKED_ADFA_MMAP_IO_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// width of the node ids, edge targets and tail offsets (Index in utils.hpp): 32, 40 or 64 bits, set by CMake
+#ifndef PACKED_ADFA_INDEX_BITS
+#define PACKED_ADFA_INDEX_BITS 32
+#endif
+
+// On-disk format of the static indexes
+//   header : magic (8 bytes), version (4 bytes), alignment (4 bytes), zero padding up to ALIGNMENT
+//   then a sequence of sections, the first one being the type tag of the index (with the index width):
+//   section: element count (8 bytes), byte size (8 bytes), zero padding up to ALIGNMENT,
+//            payload, zero padding up to ALIGNMENT (at least SECTION_SLACK bytes)
+// Every payload starts on an ALIGNMENT boundary, so arrays are used straight from the mapping.
+// The slack keeps the word-wise reads of get_lcp past the end of a string inside the mapping.
+constexpr char INDEX_FILE_MAGIC[8] = {'P', 'K', 'A', 'D', 'F', 'A', '\0', '\0'};
+constexpr std::uint32_t INDEX_FILE_VERSION = 6;
+constexpr std::size_t INDEX_FILE_ALIGNMENT = 64;
+constexpr std::size_t SECTION_SLACK = 64;
+
+class MappedFile{
+  const char* ptr = nullptr;
+  std::size_t len = 0;
+public:
+  explicit MappedFile(const std::string& path){
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+      throw std::runtime_error("cannot open \"" + path + "\"");
+    }
+    struct stat st{};
+    if(::fstat(fd, &st) != 0){
+      ::close(fd);
+      throw std::runtime_error("cannot stat \"" + path + "\"");
+    }
+    len = st.st_size;
+    if(len > 0){
+      void* addr = ::mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+      if(addr == MAP_FAILED){
+        ::close(fd);
+        throw std::runtime_error("cannot mmap \"" + path + "\"");
+      }
+      ptr = static_cast<const char*>(addr);
+    }
+    ::close(fd);
+  }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile(){
+    if(ptr != nullptr){
+      ::munmap(const_cast<char*>(ptr), len);
+    }
+  }
+  const char* data() const{
+    return ptr;
+  }
+  std::size_t size() const{
+    return len;
+  }
+};
+
+// a read-only array that either owns its elements or points into a MappedFile
+template <typename T> requires std::is_trivially_copyable_v<T>
+class MappableArray{
+  std::vector<T> owned;
+  std::shared_ptr<const MappedFile> mapping;
+  const T* ptr = nullptr;
+  std::size_t len = 0;
+  // byte arrays (strings) are read word-wise past their end by get_lcp, so the owned ones store SECTION_SLACK
+  // zero bytes after the elements, like the sections of a mapped file
+  void pad(){
+    if constexpr(sizeof(T) == 1){
+      owned.resize(len + SECTION_SLACK);
+    }
+  }
+public:
+  MappableArray() = default;
+  MappableArray(std::vector<T> vec) : owned(std::move(vec)), len(owned.size()){
+    pad();
+    ptr = owned.data();
+  }
+  // stores the elements of a vector of another type, e.g. Index values in a narrower element type
+  template <typename U> requires (!std::is_same_v<U, T> && std::is_convertible_v<const U&, T>)
+  MappableArray(const std::vector<U>& vec) : MappableArray(std::vector<T>(vec.begin(), vec.end())){}
+  MappableArray(std::span<const T> elems) : MappableArray(std::vector<T>(elems.begin(), elems.end())){}
+  MappableArray(std::shared_ptr<const MappedFile> mapping, const T* ptr, std::size_t len) : mapping(std::move(mapping)), ptr(ptr), len(len){}
+  MappableArray(const MappableArray& other) : owned(other.owned), mapping(other.mapping), len(other.len){
+    pad();
+    ptr = mapping ? other.ptr : owned.data();
+  }
+  MappableArray(MappableArray&& other) noexcept : owned(std::move(other.owned)), mapping(std::move(other.mapping)), len(other.len){
+    ptr = mapping ? other.ptr : owned.data();
+    other.ptr = nullptr;
+    other.len = 0;
+  }
+  MappableArray& operator=(const MappableArray& other){
+    if(this != &other){
+      *this = MappableArray(other);
+    }
+    return *this;
+  }
+  MappableArray& operator=(MappableArray&& other) noexcept{
+    owned = std::move(other.owned);
+    mapping = std::move(other.mapping);
+    len = other.len;
+    ptr = mapping ? other.ptr : owned.data();
+    other.ptr = nullptr;
+    other.len = 0;
+    return *this;
+  }
+  const T& operator[](std::size_t i) const{
+    return ptr[i];
+  }
+  const T* data() const{
+    return ptr;
+  }
+  std::size_t size() const{
+    return len;
+  }
+  bool empty() const{
+    return len == 0;
+  }
+  const T* begin() const{
+    return ptr;
+  }
+  const T* end() const{
+    return ptr + len;
+  }
+  bool is_mapped() const{
+    return mapping != nullptr;
+  }
+};
+
+template <typename T>
+struct is_mappable_array : std::false_type {};
+template <typename T>
+struct is_mappable_array<MappableArray<T>> : std::true_type {};
+
+class IndexWriter{
+  std::ofstream ofs;
+  std::size_t offset = 0;
+  void pad(std::size_t min_bytes){
+    std::size_t target = (offset + min_bytes + INDEX_FILE_ALIGNMENT - 1) / INDEX_FILE_ALIGNMENT * INDEX_FILE_ALIGNMENT;
+    static const char zeros[INDEX_FILE_ALIGNMENT] = {};
+    while(offset < target){
+      std::size_t len = std::min(target - offset, INDEX_FILE_ALIGNMENT);
+      ofs.write(zeros, len);
+      offset += len;
+    }
+  }
+  void write_raw(const void* data, std::size_t bytes){
+    ofs.write(static_cast<const char*>(data), bytes);
+    offset += bytes;
+  }
+  void write_section(const void* data, std::size_t count, std::size_t bytes){
+    std::uint64_t sizes[2] = {count, bytes};
+    write_raw(sizes, sizeof(sizes));
+    pad(0);
+    write_raw(data, bytes);
+    pad(SECTION_SLACK);
+  }
+public:
+  static constexpr bool loading = false;
+  explicit IndexWriter(const std::string& path, const std::string& tag) : ofs(path, std::ios::binary | std::ios::trunc){
+    if(!ofs.is_open()){
+      throw std::runtime_error("cannot create \"" + path + "\"");
+    }
+    write_raw(INDEX_FILE_MAGIC, sizeof(INDEX_FILE_MAGIC));
+    write_raw(&INDEX_FILE_VERSION, sizeof(INDEX_FILE_VERSION));
+    std::uint32_t alignment = INDEX_FILE_ALIGNMENT;
+    write_raw(&alignment, sizeof(alignment));
+    pad(0);
+    write_section(tag.data(), tag.size(), tag.size());
+  }
+  template <typename T>
+  void write(const T& val){
+    if constexpr(std::is_arithmetic_v<T>){
+      write_section(&val, 1, sizeof(T));
+    }
+    else if constexpr(is_mappable_array<T>::value){
+      write_section(val.data(), val.size(), val.size() * sizeof(*val.data()));
+    }
+    else{
+      T::serialize(val, *this);
+    }
+  }
+  template <typename... Args>
+  void operator()(const Args&... args){
+    (write(args), ...);
+  }
+  void finish(){
+    ofs.flush();
+    if(!ofs){
+      throw std::runtime_error("failed to write index file");
+    }
+  }
+};
+
+class IndexReader{
+  std::shared_ptr<const MappedFile> mapping;
+  std::size_t offset = 0;
+  void align(){
+    offset = (offset + INDEX_FILE_ALIGNMENT - 1) / INDEX_FILE_ALIGNMENT * INDEX_FILE_ALIGNMENT;
+  }
+  // returns the payload of the next section
+  std::pair<const char*, std::size_t> read_section(std::size_t elem_size){
+    if(offset + 2 * sizeof(std::uint64_t) > mapping->size()){
+      throw std::runtime_error("truncated index file");
+    }
+    std::uint64_t sizes[2];
+    std::memcpy(sizes, mapping->data() + offset, sizeof(sizes));
+    offset += sizeof(sizes);
+    align();
+    if(sizes[1] != sizes[0] * elem_size || offset + sizes[1] > mapping->size()){
+      throw std::runtime_error("corrupted index file");
+    }
+    const char* data = mapping->data() + offset;
+    offset += sizes[1] + SECTION_SLACK;
+    align();
+    return {data, sizes[0]};
+  }
+public:
+  static constexpr bool loading = true;
+  explicit IndexReader(const std::string& path, const std::string& tag) : mapping(std::make_shared<const MappedFile>(path)){
+    char magic[sizeof(INDEX_FILE_MAGIC)];
+    std::uint32_t version;
+    if(mapping->size() < INDEX_FILE_ALIGNMENT){
+      throw std::runtime_error("\"" + path + "\" is not an index file");
+    }
+    std::memcpy(magic, mapping->data(), sizeof(magic));
+    std::memcpy(&version, mapping->data() + sizeof(magic), sizeof(version));
+    if(std::memcmp(magic, INDEX_FILE_MAGIC, sizeof(magic)) != 0){
+      throw std::runtime_error("\"" + path + "\" is not an index file");
+    }
+    if(version != INDEX_FILE_VERSION){
+      throw std::runtime_error("\"" + path + "\" has format version " + std::to_string(version) + ", expected " + std::to_string(INDEX_FILE_VERSION));
+    }
+    offset = INDEX_FILE_ALIGNMENT;
+    auto [data, len] = read_section(1);
+    if(std::string(data, len) != tag){
+      throw std::runtime_error("\"" + path + "\" stores " + std::string(data, len) + ", expected " + tag);
+    }
+  }
+  template <typename T>
+  void read(T& val){
+    if constexpr(std::is_arithmetic_v<T>){
+      auto [data, len] = read_section(sizeof(T));
+      std::memcpy(&val, data, sizeof(T));
+    }
+    else if constexpr(is_mappable_array<T>::value){
+      using Elem = std::remove_cvref_t<decltype(*val.data())>;
+      auto [data, len] = read_section(sizeof(Elem));
+      val = T(mapping, reinterpret_cast<const Elem*>(data), len);
+    }
+    else{
+      T::serialize(val, *this);
+    }
+  }
+  template <typename... Args>
+  void operator()(Args&... args){
+    (read(args), ...);
+  }
+};
+
+// the type tag of T in the index files; the index width is part of it, since it changes the element sizes
+template <typename T>
+std::string index_file_tag(){
+  return std::string(typeid(T).name()) + "/" + std::to_string(PACKED_ADFA_INDEX_BITS);
+}
+
+// adds save(path) and open_mmap(path) to an index T that defines
+// template<typename Self, typename Archive> static void serialize(Self& self, Archive& ar)
+// and a default constructor accessible from this class
+template <typename T>
+class MmapSerializable{
+public:
+  void save(const std::string& path) const{
+    IndexWriter writer(path, index_file_tag<T>());
+    T::serialize(static_cast<const T&>(*this), writer);
+    writer.finish();
+  }
+  static T open_mmap(const std::string& path){
+    IndexReader reader(path, index_file_tag<T>());
+    T index;
+    T::serialize(index, reader);
+    return index;
+  }
+};
+
+#endif //PACKED_ADFA_MMAP_IO_HPP
@@ -0,0 +1,151 @@
+//
+// Created by shibh308 on 2026/10/16.
+//
+
+#ifndef PACKED_ADFA_PERF_COUNTERS_HPP
+#define PACKED_ADFA_PERF_COUNTERS_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// hardware events counted around the single-threaded search benchmark
+enum class PerfEvent{
+  LLCMisses,
+  DTLBMisses,
+  BranchMisses,
+  Instructions,
+  Cycles,
+};
+constexpr std::size_t NUM_PERF_EVENTS = 5;
+constexpr std::array<const char*, NUM_PERF_EVENTS> PERF_EVENT_NAMES = {"llc_misses", "dtlb_misses", "branch_misses", "instructions", "cycles"};
+
+// per-query counts of the PerfEvents, NaN for the events that were not counted
+struct PerfSummary {
+  std::array<double, NUM_PERF_EVENTS> per_query;
+  PerfSummary(){
+    per_query.fill(std::numeric_limits<double>::quiet_NaN());
+  }
+};
+
+// counters of the calling thread opened with perf_event_open (user space only).
+// Each event is opened on its own, so an event the CPU or the kernel does not offer (or perf_event_paranoid forbids)
+// only leaves its own column empty; off Linux nothing is counted.
+class PerfCounters{
+  std::array<int, NUM_PERF_EVENTS> fds;
+  std::array<double, NUM_PERF_EVENTS> counts{};
+#ifdef __linux__
+  static perf_event_attr attr_of(PerfEvent event){
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // the events are multiplexed when they outnumber the hardware counters, the times allow scaling the counts
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    auto cache_miss = [](std::uint64_t cache){
+      return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+    switch(event){
+      case PerfEvent::LLCMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cache_miss(PERF_COUNT_HW_CACHE_LL);
+        break;
+      case PerfEvent::DTLBMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cache_miss(PERF_COUNT_HW_CACHE_DTLB);
+        break;
+      case PerfEvent::BranchMisses:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+      case PerfEvent::Instructions:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case PerfEvent::Cycles:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+    }
+    return attr;
+  }
+#endif
+public:
+  PerfCounters(){
+    fds.fill(-1);
+#ifdef __linux__
+    for(std::size_t i = 0; i < NUM_PERF_EVENTS; ++i){
+      perf_event_attr attr = attr_of(static_cast<PerfEvent>(i));
+      fds[i] = static_cast<int>(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+    }
+#endif
+  }
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+  ~PerfCounters(){
+#ifdef __linux__
+    for(int fd : fds){
+      if(fd >= 0){
+        ::close(fd);
+      }
+    }
+#endif
+  }
+  // true if at least one event is counted
+  bool available() const{
+    for(int fd : fds){
+      if(fd >= 0){
+        return true;
+      }
+    }
+    return false;
+  }
+  void start(){
+#ifdef __linux__
+    for(int fd : fds){
+      if(fd >= 0){
+        ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+#endif
+  }
+  void stop(){
+#ifdef __linux__
+    for(std::size_t i = 0; i < NUM_PERF_EVENTS; ++i){
+      if(fds[i] >= 0){
+        ::ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        // value, time enabled, time running
+        std::uint64_t values[3];
+        if(::read(fds[i], values, sizeof(values)) != sizeof(values)){
+          ::close(fds[i]);
+          fds[i] = -1;
+          continue;
+        }
+        counts[i] = values[2] == 0 ? 0.0 : static_cast<double>(values[0]) * values[1] / values[2];
+      }
+    }
+#endif
+  }
+  // the counts of the last start()/stop() divided by the number of queries
+  PerfSummary summarize(std::size_t queries) const{
+    PerfSummary summary;
+    for(std::size_t i = 0; i < NUM_PERF_EVENTS; ++i){
+      if(fds[i] >= 0 && queries > 0){
+        summary.per_query[i] = counts[i] / queries;
+      }
+    }
+    return summary;
+  }
+};
+
+#endif //PACKED_ADFA_PERF_COUNTERS_HPP
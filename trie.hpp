@@ -1,752 +1,1552 @@
-//
-// Created by shibh308 on 2024/09/12.
-//
-
-#ifndef PACKED_ADFA_TRIE_HPP
-#define PACKED_ADFA_TRIE_HPP
-
-#include "utils.hpp"
-#include <unordered_map>
-#include <map>
-#include "sdsl/bit_vectors.hpp"
-
-
-class PatternMatcingIndex{
-  virtual bool search(const String& line) const = 0;
-};
-
-// a simple trie that supports dynamic insertion
-class BaseTrie : public PatternMatcingIndex{
-  int node_count = 1;
-  MapVector<STLMap> maps;
-public:
-  explicit BaseTrie(const Strings& data) : maps(1){
-    for(auto line : data){
-      insert(line);
-    }
-  }
-  void insert(const String& line){
-    Index node = 0;
-    for(auto ch: line){
-      Index child = maps.search(node, ch);
-      if(child == NOT_FOUND){
-        child = node_count;
-        maps.extend(++node_count);
-        maps.insert(node, ch, child);
-      }
-      node = child;
-    }
-  }
-  bool search(const String& line) const override{
-    Index node = 0;
-    for(auto ch : line){
-      node = maps.search(node, ch);
-      if(node == NOT_FOUND){
-        return false;
-      }
-    }
-    return maps.outdegree(node) == 0;
-  }
-  std::vector<std::vector<std::pair<Char, Index>>> to_vector() const{
-    return maps.to_vector();
-  }
-  void print_stats() const{
-    std::clog << "--------------------------------" << std::endl;
-    std::clog << "node count: " << node_count << std::endl;
-    std::size_t edge_count = 0;
-    std::vector<std::vector<std::pair<Char, Index>>> data = to_vector();
-    for(auto& edges : data){
-      edge_count += edges.size();
-    }
-    std::clog << "edge count: " << edge_count << std::endl;
-    std::clog << "--------------------------------" << std::endl;
-  }
-};
-
-// a static trie that uses binary search
-class BinarySearchTrie : public PatternMatcingIndex {
-  sdsl::bit_vector is_leaf;
-  BinarySearchMaps maps;
-public:
-  explicit BinarySearchTrie(const BaseTrie& base) : maps(){
-    auto data = base.to_vector();
-    is_leaf.resize(data.size());
-    for(Index i = 0; i < data.size(); ++i){
-      if(data[i].empty()){
-        is_leaf[i] = true;
-      }
-    }
-    maps = BinarySearchMaps::static_construct(data);
-    maps.reset_bv();
-  }
-  bool search(const String& line) const override{
-    Index node = 0;
-    for(auto ch : line){
-      node = maps.search(node, ch);
-      if(node == NOT_FOUND){
-        return false;
-      }
-    }
-    return is_leaf[node];
-  }
-  std::size_t memory_usage() const{
-    std::size_t memory = is_leaf.size() / 8
-                         + (sizeof(Char) + sizeof(Index) + 1) * maps.size();
-    return memory;
-  }
-};
-
-// a static trie that uses double array
-class DoubleArrayTrie : public PatternMatcingIndex{
-  sdsl::bit_vector is_leaf;
-  DoubleArrayMaps maps;
-public:
-  explicit DoubleArrayTrie(const BaseTrie& base) : maps(0){
-    std::vector<std::vector<std::pair<Char, Index>>> data = base.to_vector();
-    auto [da, cor] = DoubleArrayMaps::construct_with_reindexing(data);
-    is_leaf.resize(da.next.size());
-    assert(cor[0] == 0);
-    for(Index i = 0; i < data.size(); ++i){
-      if(data[i].empty()){
-        is_leaf[cor[i]] = true;
-      }
-    }
-    maps = std::move(da);
-  }
-  bool search(const String& line) const override{
-    Index node = 0;
-    for(auto ch : line){
-      node = maps.search(node, ch);
-      if(node == NOT_FOUND){
-        return false;
-      }
-    }
-    return is_leaf[node];
-  }
-  std::size_t memory_usage() const{
-    std::size_t memory = is_leaf.size() / 8
-                         + (sizeof(Char) + sizeof(Index)) * maps.size();
-    return memory;
-  }
-};
-
-class TailTrie : public PatternMatcingIndex{
-public:
-  String tail_str;
-  std::vector<Index> next;
-  MapVector<STLMap> maps;
-  explicit TailTrie(const BaseTrie& base) : maps(0){
-    std::vector<std::vector<std::pair<Char, Index>>> data = base.to_vector();
-    std::vector<int> number_of_paths_leaf(data.size(), 0);
-    std::vector<Index> mapping(data.size(), NOT_FOUND);
-    std::vector<std::vector<std::pair<Char, std::pair<bool, Index>>>> new_edges;
-    std::vector<std::vector<std::pair<Char, Index>>> new_data;
-    for(Index i = data.size() - 1; i >= 0; --i){
-      if(data[i].empty()){
-        number_of_paths_leaf[i] = 1;
-      }
-      for(Index j = 0; j < data[i].size(); ++j){
-        auto [ch, to] = data[i][j];
-        number_of_paths_leaf[i] += number_of_paths_leaf[to];
-      }
-    }
-    for(Index i = 0; i < data.size(); ++i){
-      if(number_of_paths_leaf[i] == 1){
-        continue;
-      }
-      mapping[i] = new_edges.size();
-      new_edges.emplace_back();
-      for(auto [ch, to] : data[i]){
-        if(number_of_paths_leaf[to] > 1){
-          new_edges.back().emplace_back(ch, std::make_pair(false, to));
-        }
-        else{
-          new_edges.back().emplace_back(ch, std::make_pair(true, tail_str.size()));
-          tail_str.emplace_back(ch);
-          Index cur = to;
-          while(true){
-            if(data[cur].empty()){
-              break;
-            }
-            tail_str.emplace_back(data[cur].front().first);
-            cur = data[cur].front().second;
-          }
-        }
-      }
-    }
-    new_data.resize(new_edges.size());
-    for(Index i = 0; i < new_edges.size(); ++i){
-      for(auto& [ch, to] : new_edges[i]){
-        if(!to.first){
-          to.second = mapping[to.second];
-        }
-        new_data[i].emplace_back(ch, to.second | (to.first << 31));
-      }
-    }
-    assert(number_of_paths_leaf[0] > 1);
-    maps = construct_maps<MapVector<STLMap>>(new_data);
-  }
-  bool search(const String& line) const override{
-    Index node = 0;
-    for(Index i = 0; i < line.size(); ++i){
-      node = maps.search(node, line[i]);
-      if(node == NOT_FOUND){
-        return false;
-      }
-      if(node & (1 << 31)){
-        Index next = node & ~(1 << 31);
-        return get_lcp(tail_str, next, line, i, line.size() - i) == line.size() - i;
-      }
-    }
-    return true;
-  }
-};
-
-class TailDoubleArrayTrie : public PatternMatcingIndex{
-  String tail_str;
-  std::vector<Index> next;
-  DoubleArrayMaps maps;
-public:
-  explicit TailDoubleArrayTrie(const TailTrie &base) : maps(0){
-    tail_str = base.tail_str;
-    std::vector<std::vector<std::pair<Char, Index>>> light_edges = base.maps.to_vector();
-    auto [da, cor] = DoubleArrayMaps::construct_without_reindexing(light_edges);
-    maps = std::move(da);
-    next = std::move(cor);
-  }
-  bool search(const String &line) const override{
-    Index node = 0;
-    for(Index i = 0; i < line.size(); ++i){
-      node = maps.search(next[node], line[i]);
-      if(node == NOT_FOUND){
-        return false;
-      }
-      if(node & (1 << 31)){
-        Index nex = node & ~(1 << 31);
-        return get_lcp(tail_str, nex, line, i, line.size() - i) == line.size() - i;
-      }
-    }
-    return true;
-  }
-  std::size_t memory_usage() const{
-    std::size_t memory = sizeof(Index) * 1
-                         + sizeof(Char) * tail_str.size()
-                         + sizeof(Index) * next.size()
-                         + (sizeof(Char) + sizeof(Index)) * maps.size();
-    return memory;
-  }
-};
-
-class TailBinarySearchTrie : public PatternMatcingIndex{
-  String tail_str;
-  std::vector<Index> next;
-  BinarySearchMaps maps;
-public:
-  explicit TailBinarySearchTrie(const TailTrie& base) : maps(){
-    tail_str = base.tail_str;
-    std::vector<std::vector<std::pair<Char, Index>>> light_edges = base.maps.to_vector();
-    maps = BinarySearchMaps::static_construct(light_edges);
-    maps.reset_bv();
-  }
-  bool search(const String& line) const override{
-    Index node = 0;
-    for(Index i = 0; i < line.size(); ++i){
-      node = maps.search(node, line[i]);
-      if(node == NOT_FOUND){
-        return false;
-      }
-      if(node & (1 << 31)){
-        Index next = node & ~(1 << 31);
-        return get_lcp(tail_str, next, line, i, line.size() - i) == line.size() - i;
-      }
-    }
-    return true;
-  }
-  std::size_t memory_usage() const{
-    std::size_t memory = sizeof(Index) * 1
-                         + sizeof(Char) * tail_str.size()
-                         + (sizeof(Char) + sizeof(Index) + 1) * maps.size();
-    return memory;
-  }
-};
-
-class PathDecomposedTrie : public PatternMatcingIndex {
-public:
-  sdsl::bit_vector is_leaf;
-  String heavy_str;
-  MapVector<STLMap> maps;
-  explicit PathDecomposedTrie(const BaseTrie& base) : maps(0){
-    std::vector<std::vector<std::pair<Char, Index>>> data = base.to_vector();
-    is_leaf.resize(data.size());
-    std::vector<std::vector<std::pair<Char, Index>>> light_edges(data.size());
-    std::vector<Index> heavy_edges(data.size(), NOT_FOUND);
-    std::vector<int> number_of_paths_leaf(data.size(), 0);
-    for(Index i = data.size() - 1; i >= 0; --i){
-      if(data[i].empty()){
-        number_of_paths_leaf[i] = 1;
-      }
-      for(Index j = 0; j < data[i].size(); ++j){
-        auto [ch, to] = data[i][j];
-        int siz = number_of_paths_leaf[to];
-        if(heavy_edges[i] == NOT_FOUND){
-          heavy_edges[i] = j;
-        }
-        else if(siz > number_of_paths_leaf[data[i][heavy_edges[i]].second]){
-          light_edges[i].emplace_back(data[i][heavy_edges[i]]);
-          heavy_edges[i] = j;
-        }
-        else{
-          light_edges[i].emplace_back(ch, to);
-        }
-        number_of_paths_leaf[i] += number_of_paths_leaf[to];
-      }
-    }
-    std::vector<Index> heavy_path;
-    std::vector<bool> heavy_edges_flag(data.size(), false);
-    heavy_str.reserve(data.size());
-    for(Index i = 0; i < data.size(); ++i){
-      if(heavy_edges_flag[i]){
-        continue;
-      }
-      Index cur = i;
-      while(true){
-        heavy_path.emplace_back(cur);
-        heavy_edges_flag[cur] = true;
-        if(heavy_edges[cur] == NOT_FOUND){
-          heavy_str.emplace_back(NULL_CHAR);
-          break;
-        }
-        heavy_str.emplace_back(data[cur][heavy_edges[cur]].first);
-        cur = data[cur][heavy_edges[cur]].second;
-      }
-    }
-    std::vector<Index> heavy_path_inv(data.size());
-    for(Index i = 0; i < heavy_path.size(); ++i){
-      heavy_path_inv[heavy_path[i]] = i;
-    }
-    for(Index i = 0; i < data.size(); ++i){
-      is_leaf[heavy_path_inv[i]] = data[i].empty();
-    }
-    std::vector<std::vector<std::pair<Char, Index>>> light_edges_inv(data.size());
-    for(Index i = 0; i < data.size(); ++i){
-      for(auto [ch, to] : light_edges[i]){
-        light_edges_inv[heavy_path_inv[i]].emplace_back(ch, heavy_path_inv[to]);
-      }
-    }
-    maps = construct_maps<MapVector<STLMap>>(light_edges_inv);
-  }
-  bool search(const String& line) const override{
-    Index node = 0;
-    for(Index i = 0; i < line.size(); ++i){
-      Index lcp = get_lcp(heavy_str, node, line, i, line.size() - i);
-      node += lcp;
-      i += lcp;
-      if(i == line.size()){
-        break;
-      }
-      node = maps.search(node, line[i]);
-      if(node == NOT_FOUND){
-        return false;
-      }
-    }
-    return is_leaf[node];
-  }
-};
-
-class PathDecomposedDoubleArrayTrie : public PatternMatcingIndex{
-  sdsl::bit_vector is_leaf;
-  String heavy_str;
-  std::vector<Index> next;
-  DoubleArrayMaps maps;
-public:
-  explicit PathDecomposedDoubleArrayTrie(const PathDecomposedTrie &base) : maps(0){
-    PathDecomposedTrie pdtrie(base);
-    heavy_str = pdtrie.heavy_str;
-    is_leaf = pdtrie.is_leaf;
-    std::vector<std::vector<std::pair<Char, Index>>> light_edges = pdtrie.maps.to_vector();
-    auto [da, cor] = DoubleArrayMaps::construct_without_reindexing(light_edges);
-    maps = std::move(da);
-    next = std::move(cor);
-  }
-  bool search(const String& line) const override{
-    Index node = 0;
-    for(Index i = 0; i < line.size(); ++i){
-      Index lcp = get_lcp(heavy_str, node, line, i, line.size() - i);
-      node += lcp;
-      i += lcp;
-      if(i == line.size()){
-        break;
-      }
-      node = maps.search(next[node], line[i]);
-      if(node == NOT_FOUND){
-        return false;
-      }
-    }
-    return is_leaf[node];
-  }
-  std::size_t memory_usage() const{
-    std::size_t memory = sizeof(Index) * 2
-                         + sizeof(Char) * heavy_str.size()
-                         + sizeof(Index) * next.size()
-                         + (sizeof(Char) + sizeof(Index)) * maps.size();
-    return memory;
-  }
-};
-
-class PathDecomposedBinarySearchTrie : public PatternMatcingIndex{
-  sdsl::bit_vector is_leaf;
-  String heavy_str;
-  BinarySearchMaps maps;
-public:
-  explicit PathDecomposedBinarySearchTrie(const PathDecomposedTrie &padfa) : maps(){
-    heavy_str = padfa.heavy_str;
-    is_leaf = padfa.is_leaf;
-    std::vector<std::vector<std::pair<Char, Index>>> light_edges = padfa.maps.to_vector();
-    maps = BinarySearchMaps::static_construct(light_edges);
-    maps.reset_bv();
-  }
-  bool search(const String& line) const override{
-    Index node = 0;
-    for(Index i = 0; i < line.size(); ++i){
-      Index lcp = get_lcp(heavy_str, node, line, i, line.size() - i);
-      node += lcp;
-      i += lcp;
-      if(i == line.size()){
-        break;
-      }
-      node = maps.search(node, line[i]);
-      if(node == NOT_FOUND){
-        return false;
-      }
-    }
-    return is_leaf[node];
-  }
-  std::size_t memory_usage() const{
-    std::size_t memory = sizeof(Index) * 2
-                         + sizeof(Char) * heavy_str.size()
-                         + (sizeof(Char) + sizeof(Index) + 1) * maps.size();
-    return memory;
-  }
-};
-
-// a static ADFA
-class BaseADFA : public PatternMatcingIndex {
-  MapVector<STLMap> maps;
-public:
-  explicit BaseADFA(const BaseTrie& base) : maps(0){
-    std::vector<std::vector<std::pair<Char, Index>>> data = base.to_vector();
-    std::map<std::vector<std::pair<Char, Index>>, Index> id_map;
-    std::vector<Index> ids(data.size(), NOT_FOUND);
-    for(Index i = data.size() - 1; i >= 0; --i){
-      std::vector<std::pair<Char, Index>> children;
-      for(auto [ch, to] : data[i]){
-        children.emplace_back(ch, ids[to]);
-      }
-      if(!id_map.contains(children)){
-        id_map[children] = id_map.size();
-      }
-      ids[i] = id_map[children];
-    }
-    std::vector<std::pair<Index, std::vector<std::pair<Char, Index>>>> sorted_id_map(id_map.size());
-    for(const auto& [children, id] : id_map){
-      sorted_id_map[id] = {id, children};
-    }
-    maps.extend(sorted_id_map.size());
-    for(const auto& [id, children] : sorted_id_map){
-      Index after_id = sorted_id_map.size() - 1 - id;
-      for(auto [ch, to] : children){
-        Index after_to = sorted_id_map.size() - 1 - to;
-        assert(after_id < after_to);
-        maps.insert(after_id, ch, after_to);
-      }
-    }
-  }
-  bool search(const String& line) const override{
-    Index node = 0;
-    for(auto ch : line){
-      node = maps.search(node, ch);
-      if(node == NOT_FOUND){
-        return false;
-      }
-    }
-    return node == maps.size() - 1;
-  }
-  std::vector<std::vector<std::pair<Char, Index>>> to_vector() const{
-    return maps.to_vector();
-  }
-  void print_stats() const{
-    std::clog << "--------------------------------" << std::endl;
-    std::vector<std::vector<std::pair<Char, Index>>> data = to_vector();
-    std::clog << "node count: " << data.size() << std::endl;
-    std::size_t edge_count = 0;
-    for(auto& edges : data){
-      edge_count += edges.size();
-    }
-    std::clog << "edge count: " << edge_count << std::endl;
-    std::clog << "--------------------------------" << std::endl;
-  }
-};
-
-// a static ADFA that uses binary search
-class BinarySearchADFA : public PatternMatcingIndex {
-  Index sink;
-  BinarySearchMaps maps;
-public:
-  explicit BinarySearchADFA(const BaseADFA& base) : maps(){
-    auto data = base.to_vector();
-    sink = data.size() - 1;
-    maps = BinarySearchMaps::static_construct(data);
-    maps.reset_bv();
-  }
-  bool search(const String& line) const override{
-    Index node = 0;
-    for(auto ch : line){
-      node = maps.search(node, ch);
-      if(node == NOT_FOUND){
-        return false;
-      }
-    }
-    return node == sink;
-  }
-  std::size_t memory_usage() const{
-    std::size_t memory = sizeof(Index) * 1
-                         + (sizeof(Char) + sizeof(Index) + 1) * maps.size();
-    return memory;
-  }
-};
-
-// a static ADFA that uses double array
-class DoubleArrayADFA : public PatternMatcingIndex {
-  Index sink;
-  DoubleArrayMaps maps;
-public:
-  explicit DoubleArrayADFA(const BaseADFA& base) : maps(0){
-    std::vector<std::vector<std::pair<Char, Index>>> data = base.to_vector();
-    auto [da, cor] = DoubleArrayMaps::construct_with_reindexing(data);
-    assert(cor[0] == 0);
-    sink = cor.back();
-    maps = std::move(da);
-  }
-  bool search(const String& line) const override{
-    Index node = 0;
-    for(auto ch : line){
-      node = maps.search(node, ch);
-      if(node == NOT_FOUND){
-        return false;
-      }
-    }
-    return node == sink;
-  }
-  std::size_t memory_usage() const{
-    std::size_t memory = sizeof(Index)
-                      + (sizeof(Char) + sizeof(Index)) * maps.size();
-    return memory;
-  }
-};
-
-class PathDecomposedADFA : public PatternMatcingIndex {
-public:
-  Index root, sink;
-  String heavy_str;
-  MapVector<STLMap> maps;
-  explicit PathDecomposedADFA(const BaseADFA& base) : maps(0){
-    std::vector<std::vector<std::pair<Char, Index>>> data = base.to_vector();
-    std::vector<std::vector<std::tuple<Char, Index, bool>>> data_with_heavy_flag(data.size());
-    for(Index i = 0; i < data.size(); ++i){
-      data_with_heavy_flag[i].resize(data[i].size());
-      for(Index j = 0; j < data[i].size(); ++j){
-        data_with_heavy_flag[i][j] = {data[i][j].first, data[i][j].second, true};
-      }
-    }
-    // first heavy path decomposition
-    std::vector<int> number_of_paths_sink(data.size(), 0);
-    number_of_paths_sink[data.size() - 1] = 1;
-    for(Index i = data.size() - 1; i >= 0; --i){
-      for(auto& [ch, to] : data[i]){
-        number_of_paths_sink[i] += number_of_paths_sink[to];
-      }
-    }
-    for(Index i = 0; i < data.size(); ++i){
-      std::pair<int, int> max = {0, 0};
-      for(Index j = 0; j < data[i].size(); ++j){
-        auto [ch, to] = data[i][j];
-        if(number_of_paths_sink[to] > max.second){
-          max = {j, number_of_paths_sink[to]};
-        }
-      }
-      for(Index j = 0; j < data[i].size(); ++j){
-        if(j != max.first){
-          std::get<2>(data_with_heavy_flag[i][j]) = false;
-        }
-      }
-    }
-    // second heavy path decomposition
-    std::vector<int> number_of_paths_root(data.size(), 0);
-    number_of_paths_root[0] = 1;
-    for(Index i = 0; i < data.size(); ++i){
-      for(auto& [ch, to] : data[i]){
-        number_of_paths_root[to] += number_of_paths_root[i];
-      }
-    }
-    std::vector<std::pair<Index, Index>> heavy_edges(data.size(), {NOT_FOUND, NOT_FOUND});
-    for(Index i = data.size() - 1; i >= 0; --i){
-      for(Index j = 0; j < data[i].size(); ++j){
-        auto [ch, to, is_heavy] = data_with_heavy_flag[i][j];
-        if(!is_heavy){
-          continue;
-        }
-        if(heavy_edges[to].first == NOT_FOUND){
-          heavy_edges[to] = {i, j};
-        }
-        else if(number_of_paths_root[i] > number_of_paths_root[heavy_edges[to].first]){
-          std::get<2>(data_with_heavy_flag[heavy_edges[to].first][heavy_edges[to].second]) = false;
-          heavy_edges[to] = {i, j};
-        }
-        else{
-          std::get<2>(data_with_heavy_flag[i][j]) = false;
-        }
-      }
-    }
-    // obtain heavy paths
-    std::vector<bool> heavy_edges_flag(data.size(), false);
-    std::vector<Index> heavy_path;
-    for(Index i = 0; i < data.size(); ++i){
-      if(heavy_edges_flag[i]){
-        continue;
-      }
-      heavy_edges_flag[i] = true;
-      heavy_path.emplace_back(i);
-      Index cur = i;
-      while(true){
-        bool has_heavy = false;
-        for(auto& [ch, to, is_heavy] : data_with_heavy_flag[cur]){
-          if(is_heavy){
-            assert(!heavy_edges_flag[to]);
-            heavy_path.emplace_back(to);
-            heavy_edges_flag[to] = true;
-            heavy_str.emplace_back(ch);
-            cur = to;
-            has_heavy = true;
-            break;
-          }
-        }
-        if(!has_heavy){
-          break;
-        }
-      }
-      heavy_str.emplace_back(NULL_CHAR);
-    }
-    assert(heavy_path.size() == data.size());
-    std::vector<Index> heavy_path_inv(data.size());
-    for(Index i = 0; i < heavy_path.size(); ++i){
-      heavy_path_inv[heavy_path[i]] = i;
-    }
-    // obtain light edges
-    std::vector<std::vector<std::pair<Char, Index>>> light_edges(data.size());
-    for(Index i = 0; i < data.size(); ++i){
-      for(auto& [ch, to, is_heavy] : data_with_heavy_flag[i]){
-        if(!is_heavy){
-          light_edges[heavy_path_inv[i]].emplace_back(ch, heavy_path_inv[to]);
-        }
-      }
-    }
-    maps = construct_maps<MapVector<STLMap>>(light_edges);
-    root = heavy_path_inv.front();
-    sink = heavy_path_inv.back();
-  }
-  bool search(const String& line) const override{
-    Index node = root;
-    for(Index i = 0; i < line.size(); ++i){
-      Index lcp = get_lcp(heavy_str, node, line, i, line.size() - i);
-      node += lcp;
-      i += lcp;
-      if(i == line.size()){
-        break;
-      }
-      node = maps.search(node, line[i]);
-      if(node == NOT_FOUND){
-        return false;
-      }
-    }
-    return node == sink;
-  }
-};
-
-class PathDecomposedDoubleArrayADFA : public PatternMatcingIndex {
-  Index root, sink;
-  String heavy_str;
-  std::vector<Index> next;
-  DoubleArrayMaps maps;
-public:
-  explicit PathDecomposedDoubleArrayADFA(const PathDecomposedADFA& pdadfa) : maps(0){
-    heavy_str = pdadfa.heavy_str;
-    root = pdadfa.root;
-    sink = pdadfa.sink;
-    std::vector<std::vector<std::pair<Char, Index>>> light_edges = pdadfa.maps.to_vector();
-    auto [da, cor] = DoubleArrayMaps::construct_without_reindexing(light_edges);
-    maps = std::move(da);
-    next = std::move(cor);
-  }
-  bool search(const String& line) const override{
-    Index node = root;
-    for(Index i = 0; i < line.size(); ++i){
-      Index lcp = get_lcp(heavy_str, node, line, i, line.size() - i);
-      node += lcp;
-      i += lcp;
-      if(i == line.size()){
-        break;
-      }
-      node = maps.search(next[node], line[i]);
-      if(node == NOT_FOUND){
-        return false;
-      }
-    }
-    return node == sink;
-  }
-  std::size_t memory_usage() const{
-    std::size_t memory = sizeof(Index) * 2
-                         + sizeof(Char) * heavy_str.size()
-                         + sizeof(Index) * next.size()
-                         + (sizeof(Char) + sizeof(Index)) * maps.size();
-    return memory;
-  }
-};
-
-class PathDecomposedBinarySearchADFA : public PatternMatcingIndex {
-  Index root, sink;
-  String heavy_str;
-  BinarySearchMaps maps;
-public:
-  explicit PathDecomposedBinarySearchADFA(const PathDecomposedADFA& padfa) : maps(){
-    heavy_str = padfa.heavy_str;
-    root = padfa.root;
-    sink = padfa.sink;
-    std::vector<std::vector<std::pair<Char, Index>>> light_edges = padfa.maps.to_vector();
-    maps = BinarySearchMaps::static_construct(light_edges);
-    maps.reset_bv();
-  }
-  bool search(const String& line) const override{
-    Index node = root;
-    for(Index i = 0; i < line.size(); ++i){
-      Index lcp = get_lcp(heavy_str, node, line, i, line.size() - i);
-      node += lcp;
-      i += lcp;
-      if(i == line.size() || node == sink){
-        break;
-      }
-      node = maps.search(node, line[i]);
-      if(node == NOT_FOUND){
-        return false;
-      }
-    }
-    return node == sink;
-  }
-  std::size_t memory_usage() const{
-    std::size_t memory = sizeof(Index) * 2
-                         + sizeof(Char) * heavy_str.size()
-                         + (sizeof(Char) + sizeof(Index) + 1) * maps.size();
-    return memory;
-  }
-};
-
-#endif //PACKED_ADFA_TRIE_HPP
+//
+// Created by shibh308 on 2024/09/12.
+//
+
+#ifndef PACKED_ADFA_TRIE_HPP
+#define PACKED_ADFA_TRIE_HPP
+
+#include "utils.hpp"
+#include <unordered_map>
+#include <map>
+#include <array>
+#include <utility>
+#include "sdsl/bit_vectors.hpp"
+
+
+// an exact-match index: search(line) tells whether line (ending with EOW) is a key.
+// The indexes are plain classes checked against this concept, so search has no virtual dispatch.
+template <typename T>
+concept PatternMatchingIndex = requires(const T& index, StringView line){
+  { index.search(line) } -> std::same_as<bool>;
+};
+
+// number of queries that are in flight at once in search_batch
+constexpr int BATCH_WIDTH = 16;
+
+struct BatchCursor{
+  std::size_t query;
+  Index node;
+  Index pos;
+  Index base;
+};
+
+// runs many lookups at once (AMAC): each slot holds one in-flight query and advances it by
+// one transition per round, so the cache miss of a slot is overlapped with the work of the others.
+// start(line, cursor, result) and step(line, cursor, result) return whether the query is still running,
+// and prefetch the memory needed by the next step before returning.
+template<typename Start, typename Step>
+void interleaved_search(std::span<const StringView> lines, std::span<bool> results, Start start, Step step){
+  assert(lines.size() == results.size());
+  std::array<BatchCursor, BATCH_WIDTH> cursors;
+  std::size_t issued = 0;
+  auto fill = [&](BatchCursor& cursor){
+    while(issued < lines.size()){
+      cursor = {issued++, 0, 0, NOT_FOUND};
+      if(start(lines[cursor.query], cursor, results[cursor.query])){
+        return true;
+      }
+    }
+    return false;
+  };
+  int live = 0;
+  while(live < BATCH_WIDTH && fill(cursors[live])){
+    ++live;
+  }
+  while(live > 0){
+    for(int j = 0; j < live;){
+      BatchCursor& cursor = cursors[j];
+      if(step(lines[cursor.query], cursor, results[cursor.query]) || fill(cursor)){
+        ++j;
+      }
+      else{
+        cursor = cursors[--live];
+      }
+    }
+  }
+}
+
+// reports the keys below node in lexicographic order (predictive_search). key holds the labels from the root to node,
+// children(node, f) calls f(label, child) in ascending label order and accepts(node) tells whether a key ends at node.
+// Every key ends with EOW, so a node where a key ends has no children.
+template<typename Children, typename Accepts, typename F>
+void enumerate_keys(Index node, String& key, const Children& children, const Accepts& accepts, F& callback){
+  if(accepts(node)){
+    callback(std::as_const(key));
+    return;
+  }
+  children(node, [&](Char ch, Index child){
+    key.emplace_back(ch);
+    enumerate_keys(child, key, children, accepts, callback);
+    key.pop_back();
+  });
+}
+
+// children of a node of a path-decomposed index: the heavy child node + 1 (if heavy is not NULL_CHAR)
+// merged by label into the light children that light(g) enumerates
+template<typename Light, typename F>
+void for_each_path_decomposed_child(Index node, Char heavy, const Light& light, F&& f){
+  bool heavy_done = heavy == NULL_CHAR;
+  light([&](Char ch, Index child){
+    if(!heavy_done && heavy < ch){
+      f(heavy, node + 1);
+      heavy_done = true;
+    }
+    f(ch, child);
+  });
+  if(!heavy_done){
+    f(heavy, node + 1);
+  }
+}
+
+// reports the key that continues in tail_str at offset pos (up to and including its EOW)
+template<typename Tail, typename F>
+void report_tail(const Tail& tail_str, Index pos, String& key, F& callback){
+  std::size_t len = key.size();
+  do{
+    key.emplace_back(tail_str[pos]);
+  } while(tail_str[pos++] != EOW);
+  callback(std::as_const(key));
+  key.resize(len);
+}
+
+// the light edges of the indexes whose maps are addressed by a base per node: the edges of node are those of next[node]
+template <typename Maps, typename Next>
+class IndirectTransitions{
+  const Maps& maps;
+  const Next& next;
+public:
+  IndirectTransitions(const Maps& maps, const Next& next) : maps(maps), next(next){}
+  Index search(Index node, Char key) const{
+    return maps.search(next[node], key);
+  }
+  template<typename F>
+  void for_each_child(Index node, F&& f) const{
+    maps.for_each_child(next[node], f);
+  }
+};
+
+// the transitions of a path-decomposed index: the heavy child node + 1 if the label is heavy_str[node], the light
+// edges otherwise. follow() moves along the heavy paths a word at a time with get_lcp.
+template <typename Heavy, typename Light>
+class HeavyPathTransitions{
+  const Heavy& heavy_str;
+  Light light;
+public:
+  HeavyPathTransitions(const Heavy& heavy_str, Light light) : heavy_str(heavy_str), light(light){}
+  Index search(Index node, Char key) const{
+    return heavy_str[node] == key ? node + 1 : light.search(node, key);
+  }
+  template<typename F>
+  void for_each_child(Index node, F&& f) const{
+    for_each_path_decomposed_child(node, heavy_str[node], [&](auto&& g){ light.for_each_child(node, g); }, f);
+  }
+  Index follow(Index node, StringView line) const{
+    for(Index i = 0; i < line.size(); ++i){
+      Index lcp = get_lcp(heavy_str, node, line, i, line.size() - i);
+      node += lcp;
+      i += lcp;
+      if(i == line.size()){
+        break;
+      }
+      node = light.search(node, line[i]);
+      if(node == NOT_FOUND){
+        return NOT_FOUND;
+      }
+    }
+    return node;
+  }
+};
+
+// the light edges are kept by reference if they are the maps of the index, by value if they are a view like IndirectTransitions
+template <typename Heavy, typename Light>
+HeavyPathTransitions<Heavy, Light> heavy_path_transitions(const Heavy& heavy_str, Light&& light){
+  return HeavyPathTransitions<Heavy, Light>(heavy_str, std::forward<Light>(light));
+}
+
+// the walks shared by the indexes, over their transitions (TransitionMaps with for_each_child)
+
+// the node that line leads to from node, NOT_FOUND if a transition is missing
+template<typename Maps>
+Index follow(const Maps& maps, Index node, StringView line){
+  if constexpr(requires{ maps.follow(node, line); }){
+    return maps.follow(node, line);
+  }
+  else{
+    for(auto ch : line){
+      node = maps.search(node, ch);
+      if(node == NOT_FOUND){
+        return NOT_FOUND;
+      }
+    }
+    return node;
+  }
+}
+
+// predictive_search: the keys below the node that prefix leads to from root; accepts(node) tells whether a key ends at node
+template<typename Maps, typename Accepts, typename F>
+void predictive_walk(const Maps& maps, Index root, StringView prefix, const Accepts& accepts, F& callback){
+  Index node = follow(maps, root, prefix);
+  if(node == NOT_FOUND){
+    return;
+  }
+  String key(prefix.begin(), prefix.end());
+  enumerate_keys(node, key, [&](Index cur, auto&& f){ maps.for_each_child(cur, f); }, accepts, callback);
+}
+
+// common_prefix_search of an ADFA, whose keys all end at sink. It takes one label at a time (heavy paths included),
+// since every node on the way may have an EOW edge to the sink.
+template<typename Maps, typename F>
+void common_prefix_walk(const Maps& maps, Index root, Index sink, std::span<const Char> text, std::size_t pos, F& callback){
+  Index node = root;
+  for(std::size_t i = pos; ; ++i){
+    if(maps.search(node, EOW) == sink){
+      callback(i - pos);
+    }
+    if(i == text.size() || text[i] <= EOW){
+      return;
+    }
+    node = maps.search(node, text[i]);
+    if(node == NOT_FOUND){
+      return;
+    }
+  }
+}
+
+// search of a tail index: a key leaves the maps at an edge with the tail flag and continues in tail_str
+template<typename Maps, typename Tail>
+bool tail_search(const Maps& maps, const Tail& tail_str, StringView line){
+  Index node = 0;
+  for(Index i = 0; i < line.size(); ++i){
+    node = maps.search(node, line[i]);
+    if(node == NOT_FOUND){
+      return false;
+    }
+    if(node & TAIL_FLAG){
+      Index next = node & ~TAIL_FLAG;
+      return get_lcp(tail_str, next, line, i, line.size() - i) == line.size() - i;
+    }
+  }
+  return true;
+}
+
+// predictive_search of a tail index: a prefix that ends inside a tail has at most the key of that tail below it
+template<typename Maps, typename Tail, typename F>
+void tail_predictive_walk(const Maps& maps, const Tail& tail_str, StringView prefix, F& callback){
+  Index node = 0;
+  for(Index i = 0; i < prefix.size(); ++i){
+    node = maps.search(node, prefix[i]);
+    if(node == NOT_FOUND){
+      return;
+    }
+    if(node & TAIL_FLAG){
+      Index next = node & ~TAIL_FLAG;
+      if(get_lcp(tail_str, next, prefix, i, prefix.size() - i) == prefix.size() - i){
+        String key(prefix.begin(), prefix.begin() + i);
+        report_tail(tail_str, next, key, callback);
+      }
+      return;
+    }
+  }
+  String key(prefix.begin(), prefix.end());
+  // the nodes left after moving the unary paths into tail_str branch, so no key ends at them
+  enumerate_keys(node, key,
+    [&](Index cur, auto&& f){
+      maps.for_each_child(cur, [&](Char ch, Index child){
+        if(child & TAIL_FLAG){
+          report_tail(tail_str, child & ~TAIL_FLAG, key, callback);
+        }
+        else{
+          f(ch, child);
+        }
+      });
+    },
+    [&](Index cur){ return false; }, callback);
+}
+
+// a simple trie that supports dynamic insertion
+class BaseTrie{
+  Index node_count = 1;
+  MapVector<STLMap> maps;
+public:
+  explicit BaseTrie(const StringViews& data) : maps(1){
+    for(auto line : data){
+      insert(line);
+    }
+  }
+  void insert(StringView line){
+    Index node = 0;
+    for(auto ch: line){
+      Index child = maps.search(node, ch);
+      if(child == NOT_FOUND){
+        child = node_count;
+        maps.extend(++node_count);
+        maps.insert(node, ch, child);
+      }
+      node = child;
+    }
+  }
+  bool search(StringView line) const{
+    Index node = follow(maps, 0, line);
+    return node != NOT_FOUND && maps.outdegree(node) == 0;
+  }
+  // calls callback(key) for every key that starts with prefix, in lexicographic order
+  template<typename F>
+  void predictive_search(StringView prefix, F callback) const{
+    predictive_walk(maps, 0, prefix, [&](Index cur){ return maps.outdegree(cur) == 0; }, callback);
+  }
+  std::vector<std::vector<std::pair<Char, Index>>> to_vector() const{
+    return maps.to_vector();
+  }
+  void print_stats() const{
+    std::clog << "--------------------------------" << std::endl;
+    std::clog << "node count: " << node_count << std::endl;
+    std::size_t edge_count = 0;
+    std::vector<std::vector<std::pair<Char, Index>>> data = to_vector();
+    for(auto& edges : data){
+      edge_count += edges.size();
+    }
+    std::clog << "edge count: " << edge_count << std::endl;
+    std::clog << "--------------------------------" << std::endl;
+  }
+  std::size_t memory_usage() const{
+    return maps.memory_usage();
+  }
+};
+
+class TailTrie{
+  // stores every distinct tail once: tails[starts[i], starts[i + 1]) is a tail and ends with its only EOW, so a tail that is
+  // a suffix of another one is the end of it. Sorted by the reversed strings, a tail is a suffix of some other tail exactly
+  // when it is a suffix of the next one, so the tails are placed from the last to the first, each inside the next one or
+  // appended. Returns the offset of every tail in shared
+  static std::vector<Index> share_suffixes(const String& tails, const std::vector<Index>& starts, PaddedString& shared){
+    Index n = starts.size();
+    auto tail = [&](Index i){
+      return StringView(tails.data() + starts[i], (i + 1 < n ? starts[i + 1] : tails.size()) - starts[i]);
+    };
+    std::vector<Index> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](Index a, Index b){
+      StringView x = tail(a), y = tail(b);
+      return std::lexicographical_compare(x.rbegin(), x.rend(), y.rbegin(), y.rend());
+    });
+    std::vector<Index> offsets(n);
+    shared.clear();
+    for(Index k = n - 1; k >= 0; --k){
+      StringView cur = tail(order[k]);
+      if(k + 1 < n){
+        StringView nex = tail(order[k + 1]);
+        if(cur.size() <= nex.size() && std::equal(cur.rbegin(), cur.rend(), nex.rbegin())){
+          offsets[order[k]] = offsets[order[k + 1]] + nex.size() - cur.size();
+          continue;
+        }
+      }
+      offsets[order[k]] = shared.size();
+      shared.append(cur);
+    }
+    return offsets;
+  }
+public:
+  PaddedString tail_str;
+  std::vector<Index> next;
+  MapVector<STLMap> maps;
+  // the bytes of the tails before share_suffixes
+  std::size_t unshared_tail_size = 0;
+  explicit TailTrie(const BaseTrie& base) : maps(0){
+    std::vector<std::vector<std::pair<Char, Index>>> data = base.to_vector();
+    std::vector<Index> number_of_paths_leaf(data.size(), 0);
+    std::vector<Index> mapping(data.size(), NOT_FOUND);
+    std::vector<std::vector<std::pair<Char, std::pair<bool, Index>>>> new_edges;
+    std::vector<std::vector<std::pair<Char, Index>>> new_data;
+    // the tails in the order of the edges to them, shared by share_suffixes afterwards
+    String tails;
+    std::vector<Index> tail_starts;
+    for(Index i = data.size() - 1; i >= 0; --i){
+      if(data[i].empty()){
+        number_of_paths_leaf[i] = 1;
+      }
+      for(Index j = 0; j < data[i].size(); ++j){
+        auto [ch, to] = data[i][j];
+        number_of_paths_leaf[i] += number_of_paths_leaf[to];
+      }
+    }
+    for(Index i = 0; i < data.size(); ++i){
+      if(number_of_paths_leaf[i] == 1){
+        continue;
+      }
+      mapping[i] = new_edges.size();
+      new_edges.emplace_back();
+      for(auto [ch, to] : data[i]){
+        if(number_of_paths_leaf[to] > 1){
+          new_edges.back().emplace_back(ch, std::make_pair(false, to));
+        }
+        else{
+          new_edges.back().emplace_back(ch, std::make_pair(true, tail_starts.size()));
+          tail_starts.emplace_back(tails.size());
+          tails.emplace_back(ch);
+          Index cur = to;
+          while(true){
+            if(data[cur].empty()){
+              break;
+            }
+            tails.emplace_back(data[cur].front().first);
+            cur = data[cur].front().second;
+          }
+        }
+      }
+    }
+    unshared_tail_size = tails.size();
+    std::vector<Index> tail_offsets = share_suffixes(tails, tail_starts, tail_str);
+    if(tail_str.size() > MAX_INDEX){
+      throw std::overflow_error("TailTrie: " + std::to_string(tail_str.size()) + " tail bytes do not fit in " + std::to_string(INDEX_BITS - 1)
+                                + " bits, build with a wider PACKED_ADFA_INDEX_BITS");
+    }
+    if(new_edges.size() > MAX_INDEX){
+      throw std::overflow_error("TailTrie: " + std::to_string(new_edges.size()) + " nodes do not fit in " + std::to_string(INDEX_BITS - 1)
+                                + " bits, build with a wider PACKED_ADFA_INDEX_BITS");
+    }
+    new_data.resize(new_edges.size());
+    for(Index i = 0; i < new_edges.size(); ++i){
+      for(auto& [ch, to] : new_edges[i]){
+        to.second = to.first ? tail_offsets[to.second] : mapping[to.second];
+        new_data[i].emplace_back(ch, to.first ? to.second | TAIL_FLAG : to.second);
+      }
+    }
+    assert(number_of_paths_leaf[0] > 1);
+    maps = construct_maps<MapVector<STLMap>>(new_data);
+  }
+  bool search(StringView line) const{
+    return tail_search(maps, tail_str, line);
+  }
+  // calls callback(key) for every key that starts with prefix, in lexicographic order
+  template<typename F>
+  void predictive_search(StringView prefix, F callback) const{
+    tail_predictive_walk(maps, tail_str, prefix, callback);
+  }
+  std::size_t memory_usage() const{
+    std::size_t memory = tail_str.capacity()
+                         + next.capacity() * sizeof(Index)
+                         + maps.memory_usage();
+    return memory;
+  }
+};
+
+class PathDecomposedTrie{
+public:
+  sdsl::bit_vector is_leaf;
+  PaddedString heavy_str;
+  MapVector<STLMap> maps;
+  // the heavy paths and the light edges as one transition map
+  auto transitions() const{
+    return heavy_path_transitions(heavy_str, maps);
+  }
+  explicit PathDecomposedTrie(const BaseTrie& base) : maps(0){
+    std::vector<std::vector<std::pair<Char, Index>>> data = base.to_vector();
+    is_leaf.resize(data.size());
+    std::vector<std::vector<std::pair<Char, Index>>> light_edges(data.size());
+    std::vector<Index> heavy_edges(data.size(), NOT_FOUND);
+    std::vector<Index> number_of_paths_leaf(data.size(), 0);
+    for(Index i = data.size() - 1; i >= 0; --i){
+      if(data[i].empty()){
+        number_of_paths_leaf[i] = 1;
+      }
+      for(Index j = 0; j < data[i].size(); ++j){
+        auto [ch, to] = data[i][j];
+        Index siz = number_of_paths_leaf[to];
+        if(heavy_edges[i] == NOT_FOUND){
+          heavy_edges[i] = j;
+        }
+        else if(siz > number_of_paths_leaf[data[i][heavy_edges[i]].second]){
+          light_edges[i].emplace_back(data[i][heavy_edges[i]]);
+          heavy_edges[i] = j;
+        }
+        else{
+          light_edges[i].emplace_back(ch, to);
+        }
+        number_of_paths_leaf[i] += number_of_paths_leaf[to];
+      }
+    }
+    std::vector<Index> heavy_path;
+    std::vector<bool> heavy_edges_flag(data.size(), false);
+    // one character per node
+    heavy_str.reserve(data.size());
+    for(Index i = 0; i < data.size(); ++i){
+      if(heavy_edges_flag[i]){
+        continue;
+      }
+      Index cur = i;
+      while(true){
+        heavy_path.emplace_back(cur);
+        heavy_edges_flag[cur] = true;
+        if(heavy_edges[cur] == NOT_FOUND){
+          heavy_str.emplace_back(NULL_CHAR);
+          break;
+        }
+        heavy_str.emplace_back(data[cur][heavy_edges[cur]].first);
+        cur = data[cur][heavy_edges[cur]].second;
+      }
+    }
+    std::vector<Index> heavy_path_inv(data.size());
+    for(Index i = 0; i < heavy_path.size(); ++i){
+      heavy_path_inv[heavy_path[i]] = i;
+    }
+    for(Index i = 0; i < data.size(); ++i){
+      is_leaf[heavy_path_inv[i]] = data[i].empty();
+    }
+    std::vector<std::vector<std::pair<Char, Index>>> light_edges_inv(data.size());
+    for(Index i = 0; i < data.size(); ++i){
+      for(auto [ch, to] : light_edges[i]){
+        light_edges_inv[heavy_path_inv[i]].emplace_back(ch, heavy_path_inv[to]);
+      }
+    }
+    maps = construct_maps<MapVector<STLMap>>(light_edges_inv);
+  }
+  bool search(StringView line) const{
+    Index node = follow(transitions(), 0, line);
+    return node != NOT_FOUND && is_leaf[node];
+  }
+  // calls callback(key) for every key that starts with prefix, in lexicographic order
+  template<typename F>
+  void predictive_search(StringView prefix, F callback) const{
+    predictive_walk(transitions(), 0, prefix, [&](Index cur){ return is_leaf[cur]; }, callback);
+  }
+  std::size_t memory_usage() const{
+    std::size_t memory = is_leaf.size() / 8
+                         + heavy_str.capacity()
+                         + maps.memory_usage();
+    return memory;
+  }
+};
+
+// a static ADFA
+class BaseADFA{
+  MapVector<STLMap> maps;
+  BaseADFA() : maps(0){}
+public:
+  // merges equivalent trie nodes. Equivalent nodes have the same height (distance to the farthest leaf),
+  // so the nodes are processed level by level from the leaves, and each level is deduplicated in parallel:
+  // every thread registers the signatures whose hash falls into its own shard.
+  explicit BaseADFA(const BaseTrie& base, unsigned int num_threads = std::thread::hardware_concurrency()) : maps(0){
+    constexpr std::size_t parallel_level_size = 1 << 14;
+    std::vector<std::vector<std::pair<Char, Index>>> data = base.to_vector();
+    Index n = data.size();
+    num_threads = std::max(num_threads, 1u);
+    std::vector<Index> height(n, 0);
+    Index max_height = 0;
+    for(Index i = n - 1; i >= 0; --i){
+      for(auto [ch, to] : data[i]){
+        height[i] = std::max(height[i], height[to] + 1);
+      }
+      max_height = std::max(max_height, height[i]);
+    }
+    std::vector<Index> level_begin(max_height + 2, 0);
+    for(Index i = 0; i < n; ++i){
+      ++level_begin[height[i] + 1];
+    }
+    std::partial_sum(level_begin.begin(), level_begin.end(), level_begin.begin());
+    // nodes of each level in descending order
+    std::vector<Index> order(n);
+    std::vector<Index> level_cur(level_begin.begin(), level_begin.end() - 1);
+    for(Index i = n - 1; i >= 0; --i){
+      order[level_cur[height[i]]++] = i;
+    }
+    // rep[i] is the largest node equivalent to i
+    std::vector<Index> rep(n, NOT_FOUND);
+    std::vector<std::size_t> sig_begin;
+    std::vector<std::uint64_t> sig, hashes;
+    for(Index h = 0; h <= max_height; ++h){
+      std::span<const Index> level(order.data() + level_begin[h], order.data() + level_begin[h + 1]);
+      unsigned int threads = level.size() >= parallel_level_size ? num_threads : 1;
+      sig_begin.assign(level.size() + 1, 0);
+      for(std::size_t j = 0; j < level.size(); ++j){
+        sig_begin[j + 1] = sig_begin[j] + data[level[j]].size();
+      }
+      sig.resize(sig_begin.back());
+      hashes.resize(level.size());
+      parallel_for(threads, [&](unsigned int t){
+        for(std::size_t j = level.size() * t / threads; j < level.size() * (t + 1) / threads; ++j){
+          std::size_t k = sig_begin[j];
+          for(auto [ch, to] : data[level[j]]){
+            sig[k++] = pack_edge(ch, rep[to]);
+          }
+          hashes[j] = hash_signature({sig.data() + sig_begin[j], sig.data() + k});
+        }
+      });
+      parallel_for(threads, [&](unsigned int t){
+        StateRegistry registry(level.size() / threads);
+        std::vector<Index> members;
+        for(std::size_t j = 0; j < level.size(); ++j){
+          if((hashes[j] >> 32) % threads != t){
+            continue;
+          }
+          auto [id, inserted] = registry.find_or_insert({sig.data() + sig_begin[j], sig.data() + sig_begin[j + 1]}, hashes[j]);
+          if(inserted){
+            members.emplace_back(level[j]);
+          }
+          rep[level[j]] = members[id];
+        }
+      });
+    }
+    // states are numbered in the order of their representatives, which puts the root first and the sink last
+    std::vector<Index> ids(n, NOT_FOUND);
+    Index size = 0;
+    for(Index i = 0; i < n; ++i){
+      if(rep[i] == i){
+        ids[i] = size++;
+      }
+    }
+    maps.extend(size);
+    for(Index i = 0; i < n; ++i){
+      if(rep[i] != i){
+        continue;
+      }
+      for(auto [ch, to] : data[i]){
+        Index after_to = ids[rep[to]];
+        assert(ids[i] < after_to);
+        maps.insert(ids[i], ch, after_to);
+      }
+    }
+  }
+  // builds the minimal ADFA directly from sorted and distinct keys without materializing the trie (Daciuk et al.).
+  // Only the states of the previous key are kept unminimized, so the peak memory is proportional to the minimal ADFA.
+  static BaseADFA construct_from_sorted(const StringViews& data){
+    // registered states, a state is registered after all of its children
+    StateRegistry registry;
+    // path[d] is the state reached by the first d characters of the previous key,
+    // its last edge leads to path[d + 1] and is linked when path[d + 1] gets registered
+    std::vector<std::vector<std::pair<Char, Index>>> path(1);
+    std::vector<std::uint64_t> signature;
+    auto replace_or_register = [&](const std::vector<std::pair<Char, Index>>& children){
+      signature.clear();
+      for(auto [ch, to] : children){
+        signature.emplace_back(pack_edge(ch, to));
+      }
+      return registry.find_or_insert(signature).first;
+    };
+    auto minimize = [&](std::size_t depth){
+      while(path.size() > depth + 1){
+        Index id = replace_or_register(path.back());
+        path.pop_back();
+        path.back().back().second = id;
+      }
+    };
+    for(std::size_t i = 0; i < data.size(); ++i){
+      StringView line = data[i];
+      std::size_t lcp = 0;
+      if(i > 0){
+        StringView prev = data[i - 1];
+        assert(view_less(prev, line));
+        while(lcp < prev.size() && lcp < line.size() && prev[lcp] == line[lcp]){
+          ++lcp;
+        }
+      }
+      minimize(lcp);
+      for(std::size_t d = lcp; d < line.size(); ++d){
+        path.back().emplace_back(line[d], NOT_FOUND);
+        path.emplace_back();
+      }
+    }
+    minimize(0);
+    replace_or_register(path.back());
+    // the root is registered last and the sink first, so reversing the ids gives root = 0 and sink = size - 1
+    Index size = registry.size();
+    BaseADFA adfa;
+    adfa.maps.extend(size);
+    for(Index id = 0; id < size; ++id){
+      Index after_id = size - 1 - id;
+      for(auto word : registry.signature(id)){
+        Char ch = word & ((1u << CHAR_BITS) - 1);
+        Index after_to = size - 1 - static_cast<Index>(word >> CHAR_BITS);
+        assert(after_id < after_to);
+        adfa.maps.insert(after_id, ch, after_to);
+      }
+    }
+    return adfa;
+  }
+  // takes the edges of an ADFA that is already minimal, with the states numbered in topological order (root = 0, sink = size - 1)
+  static BaseADFA construct_from_minimal(const std::vector<std::vector<std::pair<Char, Index>>>& data){
+    BaseADFA adfa;
+    adfa.maps.extend(data.size());
+    for(Index i = 0; i < data.size(); ++i){
+      for(auto [ch, to] : data[i]){
+        assert(i < to);
+        adfa.maps.insert(i, ch, to);
+      }
+    }
+    return adfa;
+  }
+  bool search(StringView line) const{
+    return follow(maps, 0, line) == maps.size() - 1;
+  }
+  // calls callback(len) for every key that is text[pos, pos + len) followed by EOW, in increasing len.
+  // The traversal stops at the end of text and at a NULL_CHAR or EOW in text.
+  template<typename F>
+  void common_prefix_search(std::span<const Char> text, std::size_t pos, F callback) const{
+    common_prefix_walk(maps, 0, maps.size() - 1, text, pos, callback);
+  }
+  // calls callback(key) for every key that starts with prefix, in lexicographic order
+  template<typename F>
+  void predictive_search(StringView prefix, F callback) const{
+    predictive_walk(maps, 0, prefix, [&](Index cur){ return cur == maps.size() - 1; }, callback);
+  }
+  std::vector<std::vector<std::pair<Char, Index>>> to_vector() const{
+    return maps.to_vector();
+  }
+  void print_stats() const{
+    std::clog << "--------------------------------" << std::endl;
+    std::vector<std::vector<std::pair<Char, Index>>> data = to_vector();
+    std::clog << "node count: " << data.size() << std::endl;
+    std::size_t edge_count = 0;
+    for(auto& edges : data){
+      edge_count += edges.size();
+    }
+    std::clog << "edge count: " << edge_count << std::endl;
+    std::clog << "--------------------------------" << std::endl;
+  }
+  std::size_t memory_usage() const{
+    return maps.memory_usage();
+  }
+};
+
+class PathDecomposedADFA{
+public:
+  Index root, sink;
+  PaddedString heavy_str;
+  // number of paths from each node (indexed like heavy_str) to the sink
+  std::vector<Index> number_of_paths;
+  MapVector<STLMap> maps;
+  // the heavy paths and the light edges as one transition map
+  auto transitions() const{
+    return heavy_path_transitions(heavy_str, maps);
+  }
+  explicit PathDecomposedADFA(const BaseADFA& base) : maps(0){
+    std::vector<std::vector<std::pair<Char, Index>>> data = base.to_vector();
+    std::vector<std::vector<std::tuple<Char, Index, bool>>> data_with_heavy_flag(data.size());
+    for(Index i = 0; i < data.size(); ++i){
+      data_with_heavy_flag[i].resize(data[i].size());
+      for(Index j = 0; j < data[i].size(); ++j){
+        data_with_heavy_flag[i][j] = {data[i][j].first, data[i][j].second, true};
+      }
+    }
+    // first heavy path decomposition
+    std::vector<Index> number_of_paths_sink(data.size(), 0);
+    number_of_paths_sink[data.size() - 1] = 1;
+    for(Index i = data.size() - 1; i >= 0; --i){
+      for(auto& [ch, to] : data[i]){
+        number_of_paths_sink[i] += number_of_paths_sink[to];
+      }
+    }
+    for(Index i = 0; i < data.size(); ++i){
+      std::pair<Index, Index> max = {0, 0};
+      for(Index j = 0; j < data[i].size(); ++j){
+        auto [ch, to] = data[i][j];
+        if(number_of_paths_sink[to] > max.second){
+          max = {j, number_of_paths_sink[to]};
+        }
+      }
+      for(Index j = 0; j < data[i].size(); ++j){
+        if(j != max.first){
+          std::get<2>(data_with_heavy_flag[i][j]) = false;
+        }
+      }
+    }
+    // second heavy path decomposition
+    std::vector<Index> number_of_paths_root(data.size(), 0);
+    number_of_paths_root[0] = 1;
+    for(Index i = 0; i < data.size(); ++i){
+      for(auto& [ch, to] : data[i]){
+        number_of_paths_root[to] += number_of_paths_root[i];
+      }
+    }
+    std::vector<std::pair<Index, Index>> heavy_edges(data.size(), {NOT_FOUND, NOT_FOUND});
+    for(Index i = data.size() - 1; i >= 0; --i){
+      for(Index j = 0; j < data[i].size(); ++j){
+        auto [ch, to, is_heavy] = data_with_heavy_flag[i][j];
+        if(!is_heavy){
+          continue;
+        }
+        if(heavy_edges[to].first == NOT_FOUND){
+          heavy_edges[to] = {i, j};
+        }
+        else if(number_of_paths_root[i] > number_of_paths_root[heavy_edges[to].first]){
+          std::get<2>(data_with_heavy_flag[heavy_edges[to].first][heavy_edges[to].second]) = false;
+          heavy_edges[to] = {i, j};
+        }
+        else{
+          std::get<2>(data_with_heavy_flag[i][j]) = false;
+        }
+      }
+    }
+    // obtain heavy paths
+    std::vector<bool> heavy_edges_flag(data.size(), false);
+    std::vector<Index> heavy_path;
+    for(Index i = 0; i < data.size(); ++i){
+      if(heavy_edges_flag[i]){
+        continue;
+      }
+      heavy_edges_flag[i] = true;
+      heavy_path.emplace_back(i);
+      Index cur = i;
+      while(true){
+        bool has_heavy = false;
+        for(auto& [ch, to, is_heavy] : data_with_heavy_flag[cur]){
+          if(is_heavy){
+            assert(!heavy_edges_flag[to]);
+            heavy_path.emplace_back(to);
+            heavy_edges_flag[to] = true;
+            heavy_str.emplace_back(ch);
+            cur = to;
+            has_heavy = true;
+            break;
+          }
+        }
+        if(!has_heavy){
+          break;
+        }
+      }
+      heavy_str.emplace_back(NULL_CHAR);
+    }
+    assert(heavy_path.size() == data.size());
+    std::vector<Index> heavy_path_inv(data.size());
+    for(Index i = 0; i < heavy_path.size(); ++i){
+      heavy_path_inv[heavy_path[i]] = i;
+    }
+    // obtain light edges
+    std::vector<std::vector<std::pair<Char, Index>>> light_edges(data.size());
+    for(Index i = 0; i < data.size(); ++i){
+      for(auto& [ch, to, is_heavy] : data_with_heavy_flag[i]){
+        if(!is_heavy){
+          light_edges[heavy_path_inv[i]].emplace_back(ch, heavy_path_inv[to]);
+        }
+      }
+    }
+    maps = construct_maps<MapVector<STLMap>>(light_edges);
+    root = heavy_path_inv.front();
+    sink = heavy_path_inv.back();
+    number_of_paths.resize(data.size());
+    for(Index i = 0; i < data.size(); ++i){
+      number_of_paths[heavy_path_inv[i]] = number_of_paths_sink[i];
+    }
+  }
+  bool search(StringView line) const{
+    return follow(transitions(), root, line) == sink;
+  }
+  // calls callback(len) for every key that is text[pos, pos + len) followed by EOW, in increasing len.
+  // The traversal stops at the end of text and at a NULL_CHAR or EOW in text. The heavy paths are followed
+  // one label at a time, since every node on them may have an EOW edge.
+  template<typename F>
+  void common_prefix_search(std::span<const Char> text, std::size_t pos, F callback) const{
+    common_prefix_walk(transitions(), root, sink, text, pos, callback);
+  }
+  // calls callback(key) for every key that starts with prefix, in lexicographic order
+  template<typename F>
+  void predictive_search(StringView prefix, F callback) const{
+    predictive_walk(transitions(), root, prefix, [&](Index cur){ return cur == sink; }, callback);
+  }
+  std::size_t memory_usage() const{
+    std::size_t memory = heavy_str.capacity()
+                         + number_of_paths.capacity() * sizeof(Index)
+                         + maps.memory_usage();
+    return memory;
+  }
+};
+
+// The static indexes are generated by two engines from the builder they are made of (Graph), the transition maps
+// (MapPolicy) and the stored form (Layout): FlatIndex keeps the nodes of a trie, tail trie or ADFA as they are,
+// PathDecomposedIndex the heavy paths and light edges of a path-decomposed one. The variants differ only at compile
+// time, so the search loop of each one is the walk over its own maps with nothing left to dispatch.
+
+// the stored form of an index:
+// Alphabet is the number of labels the double arrays are built for. Up to MAX_DENSE_LABELS the cells are addressed by
+// dense codes, a table read per transition, and the build throws if the keys have more labels. LABEL_RANGE addresses
+// the cells by the bytes themselves, without the table.
+// OffsetBits is the width of the base that the tail and path-decomposed double arrays keep per node (next). 32 halves
+// them in a build with 64-bit indexes; the build throws if a base does not fit.
+template <Index Alphabet = MAX_DENSE_LABELS, int OffsetBits = INDEX_BITS>
+struct IndexLayout{
+  static_assert((0 < Alphabet && Alphabet <= MAX_DENSE_LABELS) || Alphabet == LABEL_RANGE);
+  static_assert(OffsetBits == 32 || OffsetBits == INDEX_BITS);
+  static constexpr Index alphabet = Alphabet;
+  static constexpr int offset_bits = OffsetBits;
+  static constexpr bool byte_codes = Alphabet == LABEL_RANGE;
+  static std::string name(){
+    return "IndexLayout<" + std::to_string(Alphabet) + ", " + std::to_string(OffsetBits) + ">";
+  }
+};
+using ByteCodeLayout = IndexLayout<LABEL_RANGE>;
+
+// a member of the engines that a variant does not store
+struct NoMember{
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){}
+};
+
+// The map policies: the maps for a layout, how they are built from the edge lists, and the arrays the indexes keep beside
+// them (the labels of the tails and heavy paths, the bases of the nodes).
+
+// double arrays whose cells are found from a base per node: the node ids are the bases if the maps are reindexed,
+// otherwise the index maps the nodes to their bases (next)
+template <typename Cells = SplitCells>
+struct DoubleArrayPolicy{
+  template <typename Layout>
+  using Maps = DoubleArrayMaps<Cells, Layout::byte_codes>;
+  using CharArray = typename DoubleArrayStorage<Cells>::CharArray;
+  template <typename Layout>
+  using OffsetArray = std::conditional_t<(Layout::offset_bits < INDEX_BITS), MappableArray<std::uint32_t>, typename DoubleArrayStorage<Cells>::IndexArray>;
+  static constexpr bool based = true;
+  static constexpr const char* family = "DoubleArray";
+  static std::string name(){
+    return std::string(Cells::name) + "Cells";
+  }
+  // the maps and the base of every node
+  template <typename Layout>
+  static std::pair<Maps<Layout>, std::vector<Index>> build(std::vector<std::vector<std::pair<Char, Index>>>& data, bool reindex){
+    if constexpr(!Layout::byte_codes){
+      std::array<bool, LABEL_RANGE> used{};
+      Index labels = 0;
+      for(auto& edges : data){
+        for(auto [key, to] : edges){
+          labels += !used[key];
+          used[key] = true;
+        }
+      }
+      if(labels > Layout::alphabet){
+        throw std::overflow_error("DoubleArrayPolicy: the keys have " + std::to_string(labels) + " labels, the layout " + Layout::name() + " holds " + std::to_string(Layout::alphabet));
+      }
+    }
+    return reindex ? Maps<Layout>::construct_with_reindexing(data) : Maps<Layout>::construct_without_reindexing(data);
+  }
+  template <typename Layout>
+  static OffsetArray<Layout> offsets(const std::vector<Index>& bases){
+    if constexpr(Layout::offset_bits < INDEX_BITS){
+      for(Index base : bases){
+        if(static_cast<std::uint64_t>(base) >> Layout::offset_bits){
+          throw std::overflow_error("DoubleArrayPolicy: base " + std::to_string(base) + " does not fit in the offsets of " + Layout::name());
+        }
+      }
+    }
+    return OffsetArray<Layout>(bases);
+  }
+};
+
+// sorted edge lists searched by binary search, the edges of a node delimited by Directory
+template <typename Edges = SortedEdges, typename Directory = SelectDirectory>
+struct BinarySearchPolicy{
+  template <typename Layout>
+  using Maps = BinarySearchMaps<Edges, Directory>;
+  using CharArray = MappableArray<Char>;
+  template <typename Layout>
+  using OffsetArray = NoMember;
+  static constexpr bool based = false;
+  static constexpr const char* family = "BinarySearch";
+  static std::string name(){
+    return std::string(Edges::name) + "Edges, " + Directory::name + "Directory";
+  }
+  template <typename Layout>
+  static std::pair<Maps<Layout>, std::vector<Index>> build(std::vector<std::vector<std::pair<Char, Index>>>& data, bool reindex){
+    return {Maps<Layout>::static_construct(data), {}};
+  }
+};
+
+// a representation chosen per node (AdaptiveMaps)
+struct AdaptivePolicy{
+  template <typename Layout>
+  using Maps = AdaptiveMaps;
+  using CharArray = MappableArray<Char>;
+  template <typename Layout>
+  using OffsetArray = NoMember;
+  static constexpr bool based = false;
+  static constexpr const char* family = "Adaptive";
+  static std::string name(){
+    return "";
+  }
+  template <typename Layout>
+  static std::pair<Maps<Layout>, std::vector<Index>> build(std::vector<std::vector<std::pair<Char, Index>>>& data, bool reindex){
+    return {Maps<Layout>::static_construct(data), {}};
+  }
+};
+
+// the name of an engine in the benchmark rows, e.g. TailDoubleArrayTrie<SplitCells>; the layout is named if it is not the default
+template <typename MapPolicy, typename Layout>
+std::string index_name(const char* prefix, const char* graph){
+  std::string params = MapPolicy::name();
+  if constexpr(!std::is_same_v<Layout, IndexLayout<>>){
+    params += (params.empty() ? "" : ", ") + Layout::name();
+  }
+  return prefix + std::string(MapPolicy::family) + graph + (params.empty() ? "" : "<" + params + ">");
+}
+
+// lookup and access of a double-array ADFA
+struct KeyRanks{
+  Index num_keys = 0;
+  // for the cell of an edge, the number of keys that leave its node by a smaller label (bit-packed, 0 for empty cells).
+  // The lexicographic rank of a key is the sum over its edges.
+  BitPackedArray path_offsets;
+  // for access: the labels of the children of every node in label order (child_labels), the nodes in the order
+  // of their bases, which are marked in node_bases, so the rank of a base is its range in child_ranges
+  RankedBits node_bases;
+  PrefixSumDirectory child_ranges;
+  MappableArray<Char> child_labels;
+  KeyRanks() = default;
+  // data are the edges of the ADFA, bases[i] the base of node i in da (its id)
+  template <typename Maps>
+  KeyRanks(const std::vector<std::vector<std::pair<Char, Index>>>& data, const std::vector<Index>& bases, const Maps& da){
+    std::vector<Index> number_of_paths(data.size(), 0);
+    number_of_paths.back() = 1;
+    for(Index i = data.size() - 1; i >= 0; --i){
+      for(auto [ch, to] : data[i]){
+        number_of_paths[i] += number_of_paths[to];
+      }
+    }
+    num_keys = number_of_paths[0];
+    std::vector<Index> offsets(da.size(), 0);
+    for(Index i = 0; i < data.size(); ++i){
+      Index sum = 0;
+      for(auto [ch, to] : data[i]){
+        offsets[da.cell(bases[i], ch)] = sum;
+        sum += number_of_paths[to];
+      }
+    }
+    path_offsets = BitPackedArray(offsets);
+    std::vector<Index> by_base;
+    std::vector<bool> is_base(da.size(), false);
+    for(Index i = 0; i < data.size(); ++i){
+      if(!data[i].empty()){
+        by_base.emplace_back(i);
+        is_base[bases[i]] = true;
+      }
+    }
+    std::sort(by_base.begin(), by_base.end(), [&](Index a, Index b){
+      return bases[a] < bases[b];
+    });
+    std::vector<Index> starts;
+    std::vector<Char> labels;
+    starts.reserve(by_base.size() + 1);
+    for(Index i : by_base){
+      starts.emplace_back(labels.size());
+      for(auto [ch, to] : data[i]){
+        labels.emplace_back(ch);
+      }
+    }
+    starts.emplace_back(labels.size());
+    node_bases = RankedBits(is_base);
+    child_ranges = PrefixSumDirectory(starts);
+    child_labels = std::move(labels);
+  }
+  std::size_t memory_usage() const{
+    return sizeof(Index)
+           + path_offsets.memory_usage()
+           + node_bases.memory_usage()
+           + child_ranges.memory_usage()
+           + sizeof(Char) * child_labels.size();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.num_keys, self.path_offsets, self.node_bases, self.child_ranges, self.child_labels);
+  }
+};
+
+// lookup and access of a path-decomposed double-array ADFA
+struct HeavyPathRanks{
+  Index num_keys = 0;
+  // the number of keys that leave a node by a smaller label than the taken edge, as in KeyRanks:
+  // per cell for the light edges, and summed from the start of the heavy path for the heavy edges,
+  // so a run of heavy edges matched at once costs one subtraction
+  BitPackedArray light_offsets;
+  BitPackedArray heavy_offsets;
+  // for access: the labels of the light children of every node in label order
+  PrefixSumDirectory light_ranges;
+  MappableArray<Char> light_labels;
+  HeavyPathRanks() = default;
+  // light_edges are the light edges of pdadfa, bases[i] the base of node i in da
+  template <typename Heavy, typename Maps>
+  HeavyPathRanks(const PathDecomposedADFA& pdadfa, const Heavy& heavy_str, const std::vector<std::vector<std::pair<Char, Index>>>& light_edges,
+                 const std::vector<Index>& bases, const Maps& da){
+    num_keys = pdadfa.number_of_paths[pdadfa.root];
+    std::vector<Index> light(da.size(), 0), heavy(heavy_str.size() + 1, 0);
+    for(Index i = 0; i < heavy_str.size(); ++i){
+      Index sum = 0, heavy_offset = 0;
+      for_each_path_decomposed_child(i, heavy_str[i], [&](auto&& g){
+        for(auto [ch, to] : light_edges[i]){
+          g(ch, to);
+        }
+      }, [&](Char ch, Index to){
+        if(ch == heavy_str[i]){
+          heavy_offset = sum;
+        }
+        else{
+          light[da.cell(bases[i], ch)] = sum;
+        }
+        sum += pdadfa.number_of_paths[to];
+      });
+      // the sums restart at every heavy path
+      heavy[i + 1] = heavy_str[i] == NULL_CHAR ? 0 : heavy[i] + heavy_offset;
+    }
+    light_offsets = BitPackedArray(light);
+    heavy_offsets = BitPackedArray(heavy);
+    std::vector<Index> starts;
+    std::vector<Char> labels;
+    starts.reserve(light_edges.size() + 1);
+    for(auto& edges : light_edges){
+      starts.emplace_back(labels.size());
+      for(auto [ch, to] : edges){
+        labels.emplace_back(ch);
+      }
+    }
+    starts.emplace_back(labels.size());
+    light_ranges = PrefixSumDirectory(starts);
+    light_labels = std::move(labels);
+  }
+  Index heavy_offset(Index node) const{
+    return heavy_offsets[node + 1] - heavy_offsets[node];
+  }
+  std::size_t memory_usage() const{
+    return sizeof(Index)
+           + light_offsets.memory_usage() + heavy_offsets.memory_usage()
+           + light_ranges.memory_usage()
+           + sizeof(Char) * light_labels.size();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.num_keys, self.light_offsets, self.heavy_offsets, self.light_ranges, self.light_labels);
+  }
+};
+
+// a static trie (Graph = BaseTrie), tail trie (TailTrie) or ADFA (BaseADFA) over the maps of MapPolicy
+template <typename Graph, typename MapPolicy, typename Layout = IndexLayout<>>
+class FlatIndex : public MmapSerializable<FlatIndex<Graph, MapPolicy, Layout>> {
+  static_assert(std::is_same_v<Graph, BaseTrie> || std::is_same_v<Graph, TailTrie> || std::is_same_v<Graph, BaseADFA>);
+  static constexpr bool adfa = std::is_same_v<Graph, BaseADFA>;
+  static constexpr bool tails = std::is_same_v<Graph, TailTrie>;
+  // the cells of a tail trie keep the node ids, since the tail offsets are targets too, so a double array reaches the
+  // cells of a node through next. The other double arrays are reindexed: the node ids are the bases.
+  static constexpr bool indirect = tails && MapPolicy::based;
+  // lookup and access read the cell of every edge, which only the double arrays address
+  static constexpr bool ranked = adfa && MapPolicy::based;
+  using Maps = typename MapPolicy::template Maps<Layout>;
+  Maps maps;
+  // the nodes of the trie where a key ends
+  [[no_unique_address]] std::conditional_t<adfa || tails, NoMember, MappableBits> is_leaf;
+  std::conditional_t<adfa, Index, NoMember> sink{};
+  [[no_unique_address]] std::conditional_t<tails, typename MapPolicy::CharArray, NoMember> tail_str;
+  [[no_unique_address]] std::conditional_t<indirect, typename MapPolicy::template OffsetArray<Layout>, NoMember> next;
+  [[no_unique_address]] std::conditional_t<ranked, KeyRanks, NoMember> ranks;
+  FlatIndex() = default;
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.is_leaf, self.sink, self.tail_str, self.next, self.maps, self.ranks);
+  }
+  friend class MmapSerializable<FlatIndex>;
+  decltype(auto) transitions() const{
+    if constexpr(indirect){
+      return IndirectTransitions(maps, next);
+    }
+    else{
+      return (maps);
+    }
+  }
+  bool accepts(Index node) const{
+    if constexpr(adfa){
+      return node == sink;
+    }
+    else{
+      return is_leaf[node];
+    }
+  }
+public:
+  explicit FlatIndex(const Graph& graph){
+    if constexpr(tails){
+      tail_str = StringView(graph.tail_str);
+      std::vector<std::vector<std::pair<Char, Index>>> edges = graph.maps.to_vector();
+      auto [built, bases] = MapPolicy::template build<Layout>(edges, false);
+      maps = std::move(built);
+      if constexpr(indirect){
+        next = MapPolicy::template offsets<Layout>(bases);
+      }
+    }
+    else{
+      std::vector<std::vector<std::pair<Char, Index>>> data = graph.to_vector();
+      auto [built, bases] = MapPolicy::template build<Layout>(data, true);
+      assert(bases.empty() || bases[0] == 0);
+      // the id of node i: its base if the maps are reindexed, i otherwise
+      auto id = [&](Index i){
+        return bases.empty() ? i : bases[i];
+      };
+      if constexpr(adfa){
+        sink = id(data.size() - 1);
+      }
+      else{
+        std::vector<bool> leaves(bases.empty() ? data.size() : built.size(), false);
+        for(Index i = 0; i < data.size(); ++i){
+          if(data[i].empty()){
+            leaves[id(i)] = true;
+          }
+        }
+        is_leaf = MappableBits(leaves);
+      }
+      if constexpr(ranked){
+        ranks = KeyRanks(data, bases, built);
+      }
+      maps = std::move(built);
+    }
+  }
+  static std::string name(){
+    return index_name<MapPolicy, Layout>(tails ? "Tail" : "", adfa ? "ADFA" : "Trie");
+  }
+  bool search(StringView line) const{
+    if constexpr(tails){
+      return tail_search(transitions(), tail_str, line);
+    }
+    else{
+      Index node = follow(transitions(), 0, line);
+      return node != NOT_FOUND && accepts(node);
+    }
+  }
+  // calls callback(key) for every key that starts with prefix, in lexicographic order
+  template<typename F>
+  void predictive_search(StringView prefix, F callback) const{
+    if constexpr(tails){
+      tail_predictive_walk(transitions(), tail_str, prefix, callback);
+    }
+    else{
+      predictive_walk(transitions(), 0, prefix, [&](Index cur){ return accepts(cur); }, callback);
+    }
+  }
+  // calls callback(len) for every key that is text[pos, pos + len) followed by EOW, in increasing len.
+  // The traversal stops at the end of text and at a NULL_CHAR or EOW in text.
+  template<typename F>
+  void common_prefix_search(std::span<const Char> text, std::size_t pos, F callback) const requires adfa{
+    common_prefix_walk(maps, 0, sink, text, pos, callback);
+  }
+  // the double arrays prefetch the cell of the next transition. With next, a transition takes two dependent loads
+  // (next[node], then the cell), so each one gets its own round.
+  void search_batch(std::span<const StringView> lines, std::span<bool> results) const requires MapPolicy::based{
+    if constexpr(indirect){
+      interleaved_search(lines, results,
+        [&](StringView line, BatchCursor& cursor, bool& result){
+          if(line.empty()){
+            result = true;
+            return false;
+          }
+          cursor.base = next[0];
+          maps.prefetch(cursor.base, line[0]);
+          return true;
+        },
+        [&](StringView line, BatchCursor& cursor, bool& result){
+          if(cursor.base == NOT_FOUND){
+            cursor.base = next[cursor.node];
+            maps.prefetch(cursor.base, line[cursor.pos]);
+            return true;
+          }
+          cursor.node = maps.search(cursor.base, line[cursor.pos]);
+          if(cursor.node == NOT_FOUND){
+            result = false;
+            return false;
+          }
+          if(cursor.node & TAIL_FLAG){
+            Index nex = cursor.node & ~TAIL_FLAG;
+            result = get_lcp(tail_str, nex, line, cursor.pos, line.size() - cursor.pos) == line.size() - cursor.pos;
+            return false;
+          }
+          if(++cursor.pos == line.size()){
+            result = true;
+            return false;
+          }
+          cursor.base = NOT_FOUND;
+          prefetch_element(next, cursor.node);
+          return true;
+        });
+    }
+    else{
+      interleaved_search(lines, results,
+        [&](StringView line, BatchCursor& cursor, bool& result){
+          if(line.empty()){
+            result = accepts(0);
+            return false;
+          }
+          maps.prefetch(0, line[0]);
+          return true;
+        },
+        [&](StringView line, BatchCursor& cursor, bool& result){
+          cursor.node = maps.search(cursor.node, line[cursor.pos]);
+          if(cursor.node == NOT_FOUND){
+            result = false;
+            return false;
+          }
+          if(++cursor.pos == line.size()){
+            result = accepts(cursor.node);
+            return false;
+          }
+          maps.prefetch(cursor.node, line[cursor.pos]);
+          return true;
+        });
+    }
+  }
+  Index size() const requires ranked{
+    return ranks.num_keys;
+  }
+  // the lexicographic rank of line among the keys, NOT_FOUND if it is not a key
+  Index lookup(StringView line) const requires ranked{
+    Index node = 0, id = 0;
+    for(auto ch : line){
+      Index cell = maps.cell(node, ch);
+      node = maps.search(node, ch);
+      if(node == NOT_FOUND){
+        return NOT_FOUND;
+      }
+      id += ranks.path_offsets[cell];
+    }
+    return node == sink ? id : NOT_FOUND;
+  }
+  // the key of rank id, the inverse of lookup
+  String access(Index id) const requires ranked{
+    assert(0 <= id && id < ranks.num_keys);
+    String key;
+    Index node = 0;
+    while(node != sink){
+      // the child whose range of ranks contains id is the last one that starts at or before it. The ranges grow
+      // with the labels and the first one starts at 0, so it is found by bisection over the labels of the node
+      auto [l, r] = ranks.child_ranges.range(ranks.node_bases.rank(node));
+      while(r - l > 1){
+        Index mid = (l + r) >> 1;
+        if(static_cast<Index>(ranks.path_offsets[maps.cell(node, ranks.child_labels[mid])]) <= id){
+          l = mid;
+        }
+        else{
+          r = mid;
+        }
+      }
+      Char label = ranks.child_labels[l];
+      key.emplace_back(label);
+      id -= ranks.path_offsets[maps.cell(node, label)];
+      node = maps.search(node, label);
+    }
+    return key;
+  }
+  // the nodes, edges and memory of each representation of the transitions
+  void print_stats() const requires requires(const Maps& m){ m.print_stats(); }{
+    maps.print_stats();
+  }
+  std::size_t memory_usage() const{
+    std::size_t memory = maps.memory_usage();
+    if constexpr(adfa){
+      memory += sizeof(Index);
+    }
+    else if constexpr(tails){
+      memory += array_memory_usage(tail_str);
+    }
+    else{
+      memory += is_leaf.size() / 8;
+    }
+    if constexpr(indirect){
+      memory += array_memory_usage(next);
+    }
+    if constexpr(ranked){
+      memory += ranks.memory_usage();
+    }
+    return memory;
+  }
+};
+
+// a static path-decomposed trie (Graph = PathDecomposedTrie) or ADFA (PathDecomposedADFA): the heavy paths as a string,
+// the light edges in the maps of MapPolicy
+template <typename Graph, typename MapPolicy, typename Layout = IndexLayout<>>
+class PathDecomposedIndex : public MmapSerializable<PathDecomposedIndex<Graph, MapPolicy, Layout>> {
+  static_assert(std::is_same_v<Graph, PathDecomposedTrie> || std::is_same_v<Graph, PathDecomposedADFA>);
+  static constexpr bool adfa = std::is_same_v<Graph, PathDecomposedADFA>;
+  // lookup and access read the cell of every light edge, which only the double arrays address
+  static constexpr bool ranked = adfa && MapPolicy::based;
+  using Maps = typename MapPolicy::template Maps<Layout>;
+  typename MapPolicy::CharArray heavy_str;
+  Maps maps;
+  // the light edges keep the node ids, so a double array reaches the cells of a node through next
+  [[no_unique_address]] std::conditional_t<MapPolicy::based, typename MapPolicy::template OffsetArray<Layout>, NoMember> next;
+  // the nodes of the trie where a key ends
+  [[no_unique_address]] std::conditional_t<adfa, NoMember, MappableBits> is_leaf;
+  std::conditional_t<adfa, Index, NoMember> root{}, sink{};
+  [[no_unique_address]] std::conditional_t<ranked, HeavyPathRanks, NoMember> ranks;
+  PathDecomposedIndex() = default;
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.root, self.sink, self.is_leaf, self.heavy_str, self.next, self.maps, self.ranks);
+  }
+  friend class MmapSerializable<PathDecomposedIndex>;
+  // the heavy paths and the light edges as one transition map
+  auto transitions() const{
+    if constexpr(MapPolicy::based){
+      return heavy_path_transitions(heavy_str, IndirectTransitions(maps, next));
+    }
+    else{
+      return heavy_path_transitions(heavy_str, maps);
+    }
+  }
+  Index start() const{
+    if constexpr(adfa){
+      return root;
+    }
+    else{
+      return 0;
+    }
+  }
+  bool accepts(Index node) const{
+    if constexpr(adfa){
+      return node == sink;
+    }
+    else{
+      return is_leaf[node];
+    }
+  }
+public:
+  explicit PathDecomposedIndex(const Graph& graph){
+    heavy_str = StringView(graph.heavy_str);
+    if constexpr(adfa){
+      root = graph.root;
+      sink = graph.sink;
+    }
+    else{
+      is_leaf = MappableBits(graph.is_leaf);
+    }
+    std::vector<std::vector<std::pair<Char, Index>>> light_edges = graph.maps.to_vector();
+    auto [built, bases] = MapPolicy::template build<Layout>(light_edges, false);
+    if constexpr(ranked){
+      ranks = HeavyPathRanks(graph, heavy_str, light_edges, bases, built);
+    }
+    maps = std::move(built);
+    if constexpr(MapPolicy::based){
+      next = MapPolicy::template offsets<Layout>(bases);
+    }
+  }
+  static std::string name(){
+    return index_name<MapPolicy, Layout>("PathDecomposed", adfa ? "ADFA" : "Trie");
+  }
+  bool search(StringView line) const{
+    Index node = follow(transitions(), start(), line);
+    return node != NOT_FOUND && accepts(node);
+  }
+  // calls callback(key) for every key that starts with prefix, in lexicographic order
+  template<typename F>
+  void predictive_search(StringView prefix, F callback) const{
+    predictive_walk(transitions(), start(), prefix, [&](Index cur){ return accepts(cur); }, callback);
+  }
+  // calls callback(len) for every key that is text[pos, pos + len) followed by EOW, in increasing len.
+  // The traversal stops at the end of text and at a NULL_CHAR or EOW in text. The heavy paths are followed
+  // one label at a time, since every node on them may have an EOW edge.
+  template<typename F>
+  void common_prefix_search(std::span<const Char> text, std::size_t pos, F callback) const requires adfa{
+    common_prefix_walk(transitions(), root, sink, text, pos, callback);
+  }
+  Index size() const requires ranked{
+    return ranks.num_keys;
+  }
+  // the lexicographic rank of line among the keys, NOT_FOUND if it is not a key
+  Index lookup(StringView line) const requires ranked{
+    Index node = root, id = 0;
+    for(Index i = 0; i < line.size(); ++i){
+      Index lcp = get_lcp(heavy_str, node, line, i, line.size() - i);
+      id += ranks.heavy_offsets[node + lcp] - ranks.heavy_offsets[node];
+      node += lcp;
+      i += lcp;
+      if(i == line.size()){
+        break;
+      }
+      Index cell = maps.cell(next[node], line[i]);
+      node = maps.search(next[node], line[i]);
+      if(node == NOT_FOUND){
+        return NOT_FOUND;
+      }
+      id += ranks.light_offsets[cell];
+    }
+    return node == sink ? id : NOT_FOUND;
+  }
+  // the key of rank id, the inverse of lookup
+  String access(Index id) const requires ranked{
+    assert(0 <= id && id < ranks.num_keys);
+    String key;
+    Index node = root;
+    while(node != sink){
+      // the last child that starts at or before id (see FlatIndex::access): the heavy child, or the last
+      // such light child found by bisection, whichever starts later
+      Char label = heavy_str[node];
+      Index offset = label != NULL_CHAR && ranks.heavy_offset(node) <= id ? ranks.heavy_offset(node) : NOT_FOUND;
+      Index base = next[node];
+      auto light_offset = [&](Index k){
+        return static_cast<Index>(ranks.light_offsets[maps.cell(base, ranks.light_labels[k])]);
+      };
+      auto [l, r] = ranks.light_ranges.range(node);
+      if(l < r && light_offset(l) <= id){
+        while(r - l > 1){
+          Index mid = (l + r) >> 1;
+          if(light_offset(mid) <= id){
+            l = mid;
+          }
+          else{
+            r = mid;
+          }
+        }
+        if(light_offset(l) > offset){
+          label = ranks.light_labels[l];
+          offset = light_offset(l);
+        }
+      }
+      assert(offset != NOT_FOUND);
+      key.emplace_back(label);
+      id -= offset;
+      node = label == heavy_str[node] ? node + 1 : maps.search(base, label);
+    }
+    return key;
+  }
+  // the nodes, edges and memory of each representation of the transitions
+  void print_stats() const requires requires(const Maps& m){ m.print_stats(); }{
+    maps.print_stats();
+  }
+  std::size_t memory_usage() const{
+    std::size_t memory = sizeof(Index) * 2
+                         + array_memory_usage(heavy_str)
+                         + maps.memory_usage();
+    if constexpr(MapPolicy::based){
+      memory += array_memory_usage(next);
+    }
+    if constexpr(ranked){
+      memory += ranks.memory_usage();
+    }
+    return memory;
+  }
+};
+
+// the variants, by their builder and maps
+template <typename Edges = SortedEdges, typename Directory = SelectDirectory, typename Layout = IndexLayout<>>
+using BinarySearchTrie = FlatIndex<BaseTrie, BinarySearchPolicy<Edges, Directory>, Layout>;
+template <typename Cells = SplitCells, typename Layout = IndexLayout<>>
+using DoubleArrayTrie = FlatIndex<BaseTrie, DoubleArrayPolicy<Cells>, Layout>;
+template <typename Cells = SplitCells, typename Layout = IndexLayout<>>
+using TailDoubleArrayTrie = FlatIndex<TailTrie, DoubleArrayPolicy<Cells>, Layout>;
+template <typename Edges = SortedEdges, typename Directory = SelectDirectory, typename Layout = IndexLayout<>>
+using TailBinarySearchTrie = FlatIndex<TailTrie, BinarySearchPolicy<Edges, Directory>, Layout>;
+template <typename Cells = SplitCells, typename Layout = IndexLayout<>>
+using PathDecomposedDoubleArrayTrie = PathDecomposedIndex<PathDecomposedTrie, DoubleArrayPolicy<Cells>, Layout>;
+template <typename Edges = SortedEdges, typename Directory = SelectDirectory, typename Layout = IndexLayout<>>
+using PathDecomposedBinarySearchTrie = PathDecomposedIndex<PathDecomposedTrie, BinarySearchPolicy<Edges, Directory>, Layout>;
+template <typename Edges = SortedEdges, typename Directory = SelectDirectory, typename Layout = IndexLayout<>>
+using BinarySearchADFA = FlatIndex<BaseADFA, BinarySearchPolicy<Edges, Directory>, Layout>;
+template <typename Cells = SplitCells, typename Layout = IndexLayout<>>
+using DoubleArrayADFA = FlatIndex<BaseADFA, DoubleArrayPolicy<Cells>, Layout>;
+template <typename Cells = SplitCells, typename Layout = IndexLayout<>>
+using PathDecomposedDoubleArrayADFA = PathDecomposedIndex<PathDecomposedADFA, DoubleArrayPolicy<Cells>, Layout>;
+template <typename Edges = SortedEdges, typename Directory = SelectDirectory, typename Layout = IndexLayout<>>
+using PathDecomposedBinarySearchADFA = PathDecomposedIndex<PathDecomposedADFA, BinarySearchPolicy<Edges, Directory>, Layout>;
+using AdaptiveADFA = FlatIndex<BaseADFA, AdaptivePolicy>;
+using PathDecomposedAdaptiveADFA = PathDecomposedIndex<PathDecomposedADFA, AdaptivePolicy>;
+
+// the compact double-array ADFAs: next is stored XOR the cell index in 8/16/32-bit tiers (XorCells)
+using CompactDoubleArrayADFA = DoubleArrayADFA<XorCells>;
+using CompactPathDecomposedDoubleArrayADFA = PathDecomposedDoubleArrayADFA<XorCells>;
+
+static_assert(PatternMatchingIndex<BaseTrie> && PatternMatchingIndex<TailTrie> && PatternMatchingIndex<PathDecomposedTrie>
+              && PatternMatchingIndex<BaseADFA> && PatternMatchingIndex<PathDecomposedADFA>);
+static_assert(PatternMatchingIndex<BinarySearchTrie<>> && PatternMatchingIndex<TailBinarySearchTrie<>> && PatternMatchingIndex<PathDecomposedBinarySearchTrie<>>
+              && PatternMatchingIndex<BinarySearchADFA<>> && PatternMatchingIndex<PathDecomposedBinarySearchADFA<>>);
+static_assert(PatternMatchingIndex<DoubleArrayTrie<>> && PatternMatchingIndex<TailDoubleArrayTrie<>> && PatternMatchingIndex<PathDecomposedDoubleArrayTrie<>>
+              && PatternMatchingIndex<DoubleArrayADFA<>> && PatternMatchingIndex<PathDecomposedDoubleArrayADFA<>>);
+static_assert(PatternMatchingIndex<AdaptiveADFA> && PatternMatchingIndex<PathDecomposedAdaptiveADFA>);
+static_assert(TransitionMaps<MapVector<STLMap>> && TransitionMaps<DoubleArrayMaps<>> && TransitionMaps<BinarySearchMaps<>> && TransitionMaps<AdaptiveMaps>);
+
+#endif //PACKED_ADFA_TRIE_HPP
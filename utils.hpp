@@ -1,398 +1,2313 @@
-//
-// Created by shibh308 on 2024/09/12.
-//
-
-#ifndef PACKED_ADFA_UTILS_HPP
-#define PACKED_ADFA_UTILS_HPP
-
-#include <vector>
-#include <string>
-#include <map>
-#include <fstream>
-#include <random>
-#include <set>
-#include <filesystem>
-#include "sdsl/bit_vectors.hpp"
-
-using Char = unsigned char;
-using String = std::vector<Char>;
-using Strings = std::vector<String>;
-using Index = std::int32_t;
-
-constexpr Char NULL_CHAR = 0;
-constexpr Char EOW = 1;
-constexpr Index NOT_FOUND = -1;
-
-
-String convert_to_String(const std::string& str, bool add_eow){
-  String ret(str.begin(), str.end());
-  if(add_eow){
-    ret.emplace_back(EOW);
-  }
-  return ret;
-}
-
-std::string base_dir_path = "../";
-std::string data_dir_path = base_dir_path + "data/";
-std::string out_csv_path = base_dir_path + "result.csv";
-
-struct ResultCsvWriter {
-  std::ofstream ofs;
-  std::string dataset_name;
-  std::size_t num_lines, total_length;
-public:
-  explicit ResultCsvWriter(const std::string& dataset_name, std::size_t num_lines, std::size_t total_length) : dataset_name(dataset_name), num_lines(num_lines), total_length(total_length){
-    bool exists = std::filesystem::exists(out_csv_path);
-    ofs.open(out_csv_path, std::ios::app);
-    if(!exists){
-      ofs << "timestamp,dataset,lines,total_length,method,time_nanoseconds,memory_bytes" << std::endl;
-    }
-  }
-  void write(const std::string& method, std::size_t time, std::size_t memory){
-    std::time_t now = std::time(nullptr);
-    ofs << std::put_time(std::localtime(&now), "%Y-%m-%d %H:%M:%S") << ",";
-    ofs << dataset_name << ",";
-    ofs << num_lines << ",";
-    ofs << total_length << ",";
-    ofs << method << ",";
-    ofs << time << ",";
-    ofs << memory << std::endl;
-  }
-};
-
-constexpr int CHAR_BITS = 8;
-constexpr int ALPHA = 8;
-inline Index get_lsb_pos(std::uint64_t val){
-  if(val == 0){
-    return ALPHA;
-  }
-  unsigned int ctz = __builtin_ctzll(val);
-  return ctz / CHAR_BITS;
-}
-
-inline Index get_lcp(const String& str1, Index ofs1, const String& str2, Index ofs2, Index max_len){
-  unsigned int max_iter = max_len / ALPHA;
-  const auto* ptr1 = reinterpret_cast<const std::uint64_t*>(str1.data() + ofs1);
-  const auto* ptr2 = reinterpret_cast<const std::uint64_t*>(str2.data() + ofs2);
-  int i = 0;
-  while(*ptr1 == *ptr2 && i < max_iter){
-    ++i;
-    ++ptr1;
-    ++ptr2;
-  }
-  return std::min(i * ALPHA + get_lsb_pos(*ptr1 ^ *ptr2), max_len);
-}
-
-
-Strings load_dataset(const std::string& dataset_name, std::size_t length_limit){
-  std::string data_path = data_dir_path + dataset_name;
-  std::clog << "loading: " << data_path << std::endl;
-  std::ifstream file(data_path);
-  assert(file.is_open());
-  std::size_t total_bytes = 0;
-  std::vector<String> lines;
-  while(true){
-    std::string line;
-    std::getline(file, line);
-    total_bytes += line.size();
-    if(total_bytes >= length_limit){
-      break;
-    }
-    lines.emplace_back(convert_to_String(line, true));
-    if(file.eof()){
-      break;
-    }
-  }
-  std::vector<bool> occur(256, false);
-  for(auto& line : lines){
-    for(auto c : line){
-      occur[c] = true;
-    }
-  }
-  std::clog << "Loading file \"" << data_path << "\" is finished." << std::endl;
-  std::clog << "Number of lines (bef): " << lines.size() << std::endl;
-  std::clog << "Total bytes     (bef): " << total_bytes << std::endl;
-  std::sort(lines.begin(), lines.end());
-  lines.erase(std::unique(lines.begin(), lines.end()), lines.end());
-  total_bytes = std::accumulate(lines.begin(), lines.end(), 0, [](std::size_t sum, const String& line){
-    return sum + line.size();
-  });
-  std::clog << "Number of lines      : " << lines.size() << std::endl;
-  std::clog << "Total bytes          : " << total_bytes << std::endl;
-  std::clog << "Number of characters : " << std::count(occur.begin(), occur.end(), true) << std::endl;
-  std::clog << "Average length       : " << 1.0 * total_bytes / lines.size() << std::endl;
-  std::clog << std::endl;
-  return lines;
-}
-
-std::pair<Strings, Strings> split_data(const Strings& data, std::uint64_t seed = 42, double A_ratio = 0.8){
-
-  std::set<String> data_set(data.begin(), data.end());
-
-  Strings data_vec(data_set.begin(), data_set.end());
-  std::mt19937 rand(seed);
-  std::shuffle(data_vec.begin(), data_vec.end(), rand);
-  std::size_t n = data.size();
-  std::size_t train_size = n * A_ratio;
-  Strings A(data_vec.begin(), data_vec.begin() + train_size);
-  Strings B(data_vec.begin() + train_size, data_vec.end());
-  return {A, B};
-}
-
-class Maps{
-public:
-  virtual void insert(Index idx, Char key, Index val) = 0;
-  virtual Index search(Index idx, Char key) const = 0;
-};
-
-class Map{
-public:
-  virtual void insert(Char key, Index val) = 0;
-  virtual Index search(Char key) const = 0;
-  virtual std::vector<std::pair<Char, Index>> to_vector() const = 0;
-};
-
-class STLMap : public Map{
-  std::map<Char, Index> map;
-public:
-  void insert(Char key, Index val) override{
-    assert(map.find(key) == map.end());
-    map[key] = val;
-  }
-  Index search(Char key) const override{
-    auto it = map.find(key);
-    if(it == map.end()){
-      return NOT_FOUND;
-    }
-    return it->second;
-  }
-  std::size_t outdegree() const{
-    return map.size();
-  }
-  std::vector<std::pair<Char, Index>> to_vector() const override{
-    std::vector<std::pair<Char, Index>> data(map.begin(), map.end());
-    return data;
-  }
-};
-
-template <typename T> requires std::is_base_of_v<Map, T>
-class MapVector : public Maps{
-  std::vector<T> maps;
-public:
-  explicit MapVector(int size){
-    maps.resize(size);
-  }
-  void insert(Index idx, Char key, Index val) override{
-    maps[idx].insert(key, val);
-  }
-  Index search(Index idx, Char key) const override{
-    return maps[idx].search(key);
-  }
-  std::size_t outdegree(Index idx) const{
-    return maps[idx].outdegree();
-  }
-  void extend(int size){
-    maps.resize(size);
-  }
-  Index size() const{
-    return maps.size();
-  }
-  std::vector<std::vector<std::pair<Char, Index>>> to_vector() const{
-    std::vector<std::vector<std::pair<Char, Index>>> data(maps.size());
-    for(Index i = 0; i < maps.size(); ++i){
-      data[i] = maps[i].to_vector();
-    }
-    return data;
-  }
-};
-
-class DoubleArrayMaps : public Maps{
-public:
-  std::vector<Index> next;
-  std::vector<Char> check;
-  explicit DoubleArrayMaps(int size){
-    next.resize(size, NOT_FOUND);
-    check.resize(size, NULL_CHAR);
-  }
-  void insert(Index idx, Char key, Index val) override{
-    assert(("Dynamic insertion is not supported. Use static_construct.", false));
-  }
-  Index search(Index idx, Char key) const override{
-    idx += key;
-    if(check[idx] == key){
-      return next[idx];
-    }
-    return NOT_FOUND;
-  }
-  void extend(int size){
-    next.resize(size, NOT_FOUND);
-    check.resize(size, NULL_CHAR);
-  }
-  static std::pair<DoubleArrayMaps, std::vector<Index>> construct_without_reindexing(std::vector<std::vector<std::pair<Char, Index>>>& data){
-    std::vector<Index> curs(data.size(), 0);
-    DoubleArrayMaps maps(data.size());
-    Index cur = 0;
-    for(Index i = 0; i < data.size(); ++i){
-      for(; ; ++cur){
-        bool ok = true;
-        for(auto [key, to] : data[i]){
-          if(cur + key >= maps.next.size()){
-            maps.extend(cur + key + 1);
-          }
-          else if(maps.check[cur + key] != NULL_CHAR){
-            ok = false;
-            break;
-          }
-        }
-        if(ok){
-          break;
-        }
-      }
-      for(auto [key, to] : data[i]){
-        maps.check[cur + key] = key;
-        maps.next[cur + key] = to;
-      }
-      curs[i] = cur;
-      ++cur;
-    }
-    return {maps, curs};
-  }
-  static std::pair<DoubleArrayMaps, std::vector<Index>> construct_with_reindexing(std::vector<std::vector<std::pair<Char, Index>>>& data){
-    std::vector<std::vector<Index>> inv(data.size());
-    DoubleArrayMaps maps(data.size());
-    std::vector<Index> curs(data.size());
-    Index cur = 0;
-    for(Index i = 0; i < data.size(); ++i){
-      for(; ; ++cur){
-        bool ok = true;
-        for(auto [key, to] : data[i]){
-          if(cur + key >= maps.next.size()){
-            maps.extend(cur + key + 1);
-          }
-          else if(maps.check[cur + key] != NULL_CHAR){
-            ok = false;
-            break;
-          }
-        }
-        if(ok){
-          break;
-        }
-      }
-      for(auto [key, to] : data[i]){
-        maps.check[cur + key] = key;
-        if(!(to & (1 << 31))){
-          inv[to].emplace_back(cur + key);
-        }
-      }
-      curs[i] = cur;
-      for(auto idx : inv[i]){
-        maps.next[idx] = cur;
-      }
-      ++cur;
-    }
-    return {maps, curs};
-  }
-  Index size() const{
-    return next.size();
-  }
-};
-
-class BinarySearchMaps : public Maps{
-  sdsl::bit_vector bv;
-  sdsl::rank_support_v<1> rank;
-  sdsl::select_support_mcl<1> select;
-  std::vector<std::pair<Char, Index>> elms;
-public:
-  explicit BinarySearchMaps(){}
-  void insert(Index idx, Char key, Index val) override{
-    assert(("Dynamic insertion is not supported. Use static_construct.", false));
-  }
-  static BinarySearchMaps static_construct(const std::vector<std::vector<std::pair<Char, Index>>>& _data){
-    std::vector<std::vector<std::pair<Char, Index>>> data = _data;
-    Index total_size = std::accumulate(data.begin(), data.end(), 0, [](Index sum, const std::vector<std::pair<Char, Index>>& vec){
-      return sum + vec.size();
-    });
-    sdsl::bit_vector bv(total_size + data.size() + 1);
-    std::vector<std::pair<Char, Index>> elms;
-    elms.reserve(total_size);
-    Index cur = 0;
-    for(Index i = 0; i < data.size(); ++i){
-      bv[cur++] = true;
-      std::sort(data[i].begin(), data[i].end());
-      for(auto [key, val] : data[i]){
-        elms.emplace_back(key, val);
-        bv[cur++] = false;
-      }
-    }
-    bv[cur++] = true;
-    assert(bv.size() == cur);
-    BinarySearchMaps maps;
-    maps.bv = std::move(bv);
-    maps.elms = std::move(elms);
-    return maps;
-  }
-  void reset_bv(){
-    rank = sdsl::rank_support_v<1>(&bv);
-    select = sdsl::select_support_mcl<1>(&bv);
-  }
-  Index search(Index idx, Char key) const override{
-    Index l = select(idx + 1);
-    l = l - rank(l);
-    Index r = select(idx + 2);
-    r = r - rank(r);
-    constexpr int linear_search_border = 5;
-    while(r - l > linear_search_border){
-      Index mid = (r + l) >> 1u;
-      if(elms[mid].first == key){
-        return elms[mid].second;
-      }else if(elms[mid].first < key){
-        l = mid;
-      }else{
-        r = mid;
-      }
-    }
-    for(unsigned int i = l; i < r; ++i){
-      if(elms[i].first == key){
-        return elms[i].second;
-      }
-      else if(key < elms[i].first){
-        return NOT_FOUND;
-      }
-    }
-    return NOT_FOUND;
-  }
-  Index size() const{
-    return elms.size();
-  }
-};
-
-template <typename T> requires std::is_base_of_v<Map, T>
-T construct_map(std::vector<std::pair<Char, Index>>& data){
-  T map;
-  for(auto [key, val] : data){
-    map.insert(key, val);
-  }
-  return map;
-}
-
-template<typename U>
-MapVector<U> construct_maps(std::vector<std::vector<std::pair<Char, Index>>>& data){
-  MapVector<U> maps(data.size());
-  for(Index i = 0; i < data.size(); ++i){
-    maps[i] = construct_map<U>(data[i]);
-  }
-  return maps;
-}
-
-template <typename T> requires std::is_base_of_v<Maps, T>
-T construct_maps(std::vector<std::vector<std::pair<Char, Index>>>& data){
-  T maps(data.size());
-  for(Index i = 0; i < data.size(); ++i){
-    for(auto [key, val] : data[i]){
-      maps.insert(i, key, val);
-    }
-  }
-  return maps;
-}
-
-#endif //PACKED_ADFA_UTILS_HPP
+//
+// Created by shibh308 on 2024/09/12.
+//
+
+#ifndef PACKED_ADFA_UTILS_HPP
+#define PACKED_ADFA_UTILS_HPP
+
+#include <vector>
+#include <string>
+#include <map>
+#include <fstream>
+#include <random>
+#include <set>
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <span>
+#include <concepts>
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <utility>
+#include <cstring>
+#include <limits>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <pthread.h>
+#endif
+#include <bit>
+#include <chrono>
+#include "sdsl/bit_vectors.hpp"
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "mmap_io.hpp"
+#include "perf_counters.hpp"
+
+using Char = unsigned char;
+using String = std::vector<Char>;
+using Strings = std::vector<String>;
+// a key that lives in a StringPool (or any other String)
+using StringView = std::span<const Char>;
+using StringViews = std::vector<StringView>;
+
+// the node ids, edge targets and tail offsets are INDEX_BITS wide (PACKED_ADFA_INDEX_BITS, see CMakeLists.txt).
+// 40-bit indexes are computed in 64 bits and stored in 5 bytes (StoredIndex), so the dictionaries
+// with more than 2^31 states or tail bytes do not pay 8 bytes per stored index.
+constexpr int INDEX_BITS = PACKED_ADFA_INDEX_BITS;
+static_assert(INDEX_BITS == 32 || INDEX_BITS == 40 || INDEX_BITS == 64, "PACKED_ADFA_INDEX_BITS must be 32, 40 or 64");
+using Index = std::conditional_t<INDEX_BITS == 32, std::int32_t, std::int64_t>;
+
+constexpr Char NULL_CHAR = 0;
+constexpr Char EOW = 1;
+constexpr Index NOT_FOUND = -1;
+// the top bit of an index marks an edge target that is an offset into tail_str (tail tries)
+constexpr Index TAIL_FLAG = static_cast<Index>(std::uint64_t(1) << (INDEX_BITS - 1));
+// the largest node id or tail offset, the bits below TAIL_FLAG
+constexpr Index MAX_INDEX = static_cast<Index>((std::uint64_t(1) << (INDEX_BITS - 1)) - 1);
+
+// a String followed by SECTION_SLACK bytes of NULL_CHAR for the word-wise reads of get_lcp past its end.
+// The slack is part of the stored vector, so it is initialized and kept by copies, unlike spare capacity
+class PaddedString{
+  String chars = String(SECTION_SLACK, NULL_CHAR);
+  std::size_t len = 0;
+public:
+  PaddedString() = default;
+  explicit PaddedString(StringView str) : chars(str.begin(), str.end()), len(str.size()){
+    chars.resize(len + SECTION_SLACK, NULL_CHAR);
+  }
+  void reserve(std::size_t size){
+    chars.reserve(size + SECTION_SLACK);
+  }
+  void clear(){
+    chars.assign(SECTION_SLACK, NULL_CHAR);
+    len = 0;
+  }
+  void emplace_back(Char c){
+    chars[len++] = c;
+    chars.emplace_back(NULL_CHAR);
+  }
+  void append(StringView str){
+    chars.insert(chars.begin() + len, str.begin(), str.end());
+    len += str.size();
+  }
+  Char operator[](std::size_t i) const{
+    return chars[i];
+  }
+  const Char* data() const{
+    return chars.data();
+  }
+  std::size_t size() const{
+    return len;
+  }
+  bool empty() const{
+    return len == 0;
+  }
+  const Char* begin() const{
+    return chars.data();
+  }
+  const Char* end() const{
+    return chars.data() + len;
+  }
+  std::size_t capacity() const{
+    return chars.capacity();
+  }
+  operator StringView() const{
+    return StringView(chars.data(), len);
+  }
+};
+
+// an Index in 5 bytes (little endian). The values are NOT_FOUND and [0, 2^40 - 1), which covers
+// the ids and offsets with and without TAIL_FLAG; the 40 bits of NOT_FOUND (all ones) decode to NOT_FOUND again
+class Index40{
+  static constexpr std::int64_t MASK = (std::int64_t(1) << 40) - 1;
+  std::array<std::uint8_t, 5> bytes;
+public:
+  Index40() = default;
+  Index40(Index val){
+    assert(val == NOT_FOUND || (0 <= val && val < MASK));
+    std::memcpy(bytes.data(), &val, bytes.size());
+  }
+  operator Index() const{
+    std::int64_t val = 0;
+    std::memcpy(&val, bytes.data(), bytes.size());
+    return ((val + 1) & MASK) - 1;
+  }
+};
+// the element type of the stored index arrays
+using StoredIndex = std::conditional_t<INDEX_BITS == 40, Index40, Index>;
+// number of distinct labels, i.e. the span of cells a double-array base may touch
+constexpr Index LABEL_RANGE = 256;
+// the most labels that get dense codes in a double array: their σ + 2 codes fit in a byte
+constexpr Index MAX_DENSE_LABELS = LABEL_RANGE - 2;
+
+
+String convert_to_String(const std::string& str, bool add_eow){
+  String ret(str.begin(), str.end());
+  if(add_eow){
+    ret.emplace_back(EOW);
+  }
+  return ret;
+}
+
+inline bool view_less(StringView a, StringView b){
+  int cmp = std::memcmp(a.data(), b.data(), std::min(a.size(), b.size()));
+  return cmp != 0 ? cmp < 0 : a.size() < b.size();
+}
+
+std::string base_dir_path = "../";
+std::string data_dir_path = base_dir_path + "data/";
+std::string out_csv_path = base_dir_path + "result.csv";
+std::string build_metrics_csv_path = base_dir_path + "build_metrics.csv";
+
+// quantiles of the per-query latency columns
+constexpr std::array<double, 4> LATENCY_QUANTILES = {0.5, 0.9, 0.99, 0.999};
+constexpr std::array<const char*, 4> LATENCY_QUANTILE_NAMES = {"p50", "p90", "p99", "p999"};
+
+struct LatencySummary {
+  // latency quantiles in nanoseconds over all repeats
+  std::array<double, LATENCY_QUANTILES.size()> quantiles{};
+  // variance of each quantile between the repeats
+  std::array<double, LATENCY_QUANTILES.size()> variances{};
+};
+
+struct ResultRow {
+  std::string method;
+  std::size_t time_nanoseconds = 0;
+  std::size_t memory_bytes = 0;
+  std::size_t threads = 1;
+  std::size_t queries = 0;
+  // throughput of the individual worker threads
+  double mean_thread_queries_per_second = 0;
+  double min_thread_queries_per_second = 0;
+  // ratio of the used double-array cells (construction rows)
+  double fill_rate = 0;
+  // per-query latency of the positive and negative queries (latency rows)
+  LatencySummary positive_latency;
+  LatencySummary negative_latency;
+  // hardware events per query (single-threaded search rows with --perf)
+  PerfSummary perf;
+};
+
+// the latency columns: {positive,negative}_{p50,...}_ns, then {positive,negative}_{p50,...}_var,
+// followed by the hardware event columns {llc_misses,...}_per_query
+inline std::string latency_header(){
+  std::string header;
+  for(const char* kind : {"positive", "negative"}){
+    for(const char* suffix : {"_ns", "_var"}){
+      for(const char* name : LATENCY_QUANTILE_NAMES){
+        header += std::string(",") + kind + "_" + name + suffix;
+      }
+    }
+  }
+  for(const char* name : PERF_EVENT_NAMES){
+    header += std::string(",") + name + "_per_query";
+  }
+  return header;
+}
+
+// quotes a csv field that contains a comma or a quote, e.g. the demangled name of a class template with two parameters
+inline std::string csv_field(const std::string& field){
+  if(field.find_first_of(",\"") == std::string::npos){
+    return field;
+  }
+  std::string quoted = "\"";
+  for(char c : field){
+    quoted += c == '"' ? "\"\"" : std::string(1, c);
+  }
+  return quoted + "\"";
+}
+
+// opens the csv file at path for appending and writes the header to a new file
+inline void open_csv(std::ofstream& ofs, const std::string& path, const std::string& header){
+  bool exists = std::filesystem::exists(path);
+  if(exists){
+    std::ifstream ifs(path);
+    std::string first_line;
+    std::getline(ifs, first_line);
+    if(first_line != header){
+      // keep results written with an older set of columns, under the first of path.old, path.old.1, ... that is not taken
+      std::string old_path = path + ".old";
+      for(int i = 1; std::filesystem::exists(old_path); ++i){
+        old_path = path + ".old." + std::to_string(i);
+      }
+      std::filesystem::rename(path, old_path);
+      std::clog << "moved \"" << path << "\" with outdated columns to \"" << old_path << "\"" << std::endl;
+      exists = false;
+    }
+  }
+  ofs.open(path, std::ios::app);
+  if(!exists){
+    ofs << header << std::endl;
+  }
+}
+
+struct ResultCsvWriter {
+  inline static const std::string header = "timestamp,dataset,lines,total_length,method,time_nanoseconds,memory_bytes,"
+                                           "threads,queries_per_second,mean_thread_queries_per_second,min_thread_queries_per_second,fill_rate" + latency_header();
+  std::ofstream ofs;
+  std::string dataset_name;
+  std::size_t num_lines, total_length;
+public:
+  explicit ResultCsvWriter(const std::string& dataset_name, std::size_t num_lines, std::size_t total_length) : dataset_name(dataset_name), num_lines(num_lines), total_length(total_length){
+    open_csv(ofs, out_csv_path, header);
+  }
+  void write(const ResultRow& row){
+    std::time_t now = std::time(nullptr);
+    ofs << std::put_time(std::localtime(&now), "%Y-%m-%d %H:%M:%S") << ",";
+    ofs << dataset_name << ",";
+    ofs << num_lines << ",";
+    ofs << total_length << ",";
+    ofs << csv_field(row.method) << ",";
+    ofs << row.time_nanoseconds << ",";
+    ofs << row.memory_bytes << ",";
+    ofs << row.threads << ",";
+    ofs << (row.time_nanoseconds == 0 ? 0.0 : row.queries * 1e9 / row.time_nanoseconds) << ",";
+    ofs << row.mean_thread_queries_per_second << ",";
+    ofs << row.min_thread_queries_per_second << ",";
+    ofs << row.fill_rate;
+    for(const LatencySummary* latency : {&row.positive_latency, &row.negative_latency}){
+      for(double quantile : latency->quantiles){
+        ofs << "," << quantile;
+      }
+      for(double variance : latency->variances){
+        ofs << "," << variance;
+      }
+    }
+    // the events that were not counted are left empty
+    for(double count : row.perf.per_query){
+      ofs << ",";
+      if(!std::isnan(count)){
+        ofs << count;
+      }
+    }
+    ofs << std::endl;
+  }
+};
+
+// resident set size of the process in bytes (VmRSS), 0 if unknown
+inline std::size_t current_rss_bytes(){
+#ifdef __linux__
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  std::size_t kib;
+  while(status >> key){
+    if(key == "VmRSS:" && status >> kib){
+      return kib * 1024;
+    }
+    status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+#endif
+  return 0;
+}
+
+// peak resident set size of the process in bytes: VmHWM, which reset_peak_rss() sets back to the current RSS,
+// or the lifetime peak of getrusage when /proc is not available
+inline std::size_t peak_rss_bytes(){
+#ifdef __linux__
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  std::size_t kib;
+  while(status >> key){
+    if(key == "VmHWM:" && status >> kib){
+      return kib * 1024;
+    }
+    status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+  }
+#endif
+  rusage usage{};
+  ::getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return usage.ru_maxrss * 1024;
+#endif
+}
+
+// starts a new peak RSS window (Linux 4.0+); returns false if peak_rss_bytes() keeps reporting the lifetime peak
+inline bool reset_peak_rss(){
+#ifdef __linux__
+  std::ofstream clear_refs("/proc/self/clear_refs");
+  return static_cast<bool>(clear_refs << "5" << std::flush);
+#else
+  return false;
+#endif
+}
+
+struct StageMetrics {
+  std::size_t time_nanoseconds = 0;
+  std::size_t rss_before_bytes = 0;
+  // the highest RSS while the stage ran (of the whole run if the peak could not be reset)
+  std::size_t peak_rss_bytes = 0;
+  bool stage_peak = false;
+};
+
+// measures the time and the peak RSS from its construction to finish()
+class StageMeter{
+  StageMetrics metrics;
+  std::chrono::high_resolution_clock::time_point start;
+public:
+  StageMeter(){
+    metrics.stage_peak = reset_peak_rss();
+    metrics.rss_before_bytes = current_rss_bytes();
+    start = std::chrono::high_resolution_clock::now();
+  }
+  StageMetrics finish(){
+    std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+    metrics.time_nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    metrics.peak_rss_bytes = peak_rss_bytes();
+    return metrics;
+  }
+};
+
+// one row per construction stage: time, the memory_usage() of the result and the RSS during the stage
+struct BuildMetricsCsvWriter {
+  inline static const std::string header = "timestamp,dataset,lines,total_length,stage,time_nanoseconds,memory_bytes,"
+                                           "rss_before_bytes,peak_rss_bytes,peak_rss_growth_bytes,peak_rss_scope";
+  std::ofstream ofs;
+  std::string dataset_name;
+  std::size_t num_lines, total_length;
+public:
+  explicit BuildMetricsCsvWriter(const std::string& dataset_name, std::size_t num_lines, std::size_t total_length) : dataset_name(dataset_name), num_lines(num_lines), total_length(total_length){
+    open_csv(ofs, build_metrics_csv_path, header);
+  }
+  void write(const std::string& stage, const StageMetrics& metrics, std::size_t memory_bytes){
+    std::time_t now = std::time(nullptr);
+    ofs << std::put_time(std::localtime(&now), "%Y-%m-%d %H:%M:%S") << ",";
+    ofs << dataset_name << ",";
+    ofs << num_lines << ",";
+    ofs << total_length << ",";
+    ofs << csv_field(stage) << ",";
+    ofs << metrics.time_nanoseconds << ",";
+    ofs << memory_bytes << ",";
+    ofs << metrics.rss_before_bytes << ",";
+    ofs << metrics.peak_rss_bytes << ",";
+    ofs << (metrics.peak_rss_bytes > metrics.rss_before_bytes ? metrics.peak_rss_bytes - metrics.rss_before_bytes : 0) << ",";
+    ofs << (metrics.stage_peak ? "stage" : "process") << std::endl;
+  }
+};
+
+// a cheap timestamp for timing single queries: the time stamp counter on x86-64, steady_clock elsewhere
+inline std::uint64_t read_timestamp(){
+#if defined(__x86_64__)
+  // the fences keep the query from moving across the reads
+  _mm_lfence();
+  std::uint64_t ticks = __rdtsc();
+  _mm_lfence();
+  return ticks;
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// length of a read_timestamp tick in nanoseconds, calibrated once against steady_clock
+inline double nanoseconds_per_tick(){
+  static const double ratio = [](){
+#if defined(__x86_64__)
+    auto start = std::chrono::steady_clock::now();
+    std::uint64_t start_ticks = read_timestamp();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::uint64_t end_ticks = read_timestamp();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / (end_ticks - start_ticks);
+#else
+    return 1.0;
+#endif
+  }();
+  return ratio;
+}
+
+// a log-linear histogram of tick counts in the style of HdrHistogram: values below 2^SUB_BITS get a bucket each,
+// larger values share a bucket with the values of the same SUB_BITS + 1 leading bits, so the relative error is below 2^-SUB_BITS
+class LatencyHistogram{
+  static constexpr int SUB_BITS = 5;
+  static constexpr std::uint64_t SUB_COUNT = 1ull << SUB_BITS;
+  std::vector<std::uint64_t> counts = std::vector<std::uint64_t>((65 - SUB_BITS) * SUB_COUNT, 0);
+  std::uint64_t total = 0;
+  static std::size_t bucket_of(std::uint64_t ticks){
+    if(ticks < SUB_COUNT){
+      return ticks;
+    }
+    int shift = std::bit_width(ticks) - 1 - SUB_BITS;
+    return ((shift + 1) << SUB_BITS) + (ticks >> shift) - SUB_COUNT;
+  }
+  // the midpoint of the values in the bucket
+  static double value_of(std::size_t bucket){
+    if(bucket < SUB_COUNT){
+      return bucket;
+    }
+    int shift = (bucket >> SUB_BITS) - 1;
+    std::uint64_t lower = (SUB_COUNT + (bucket & (SUB_COUNT - 1))) << shift;
+    return lower + ((1ull << shift) - 1) / 2.0;
+  }
+public:
+  void record(std::uint64_t ticks){
+    ++counts[bucket_of(ticks)];
+    ++total;
+  }
+  void merge(const LatencyHistogram& other){
+    for(std::size_t i = 0; i < counts.size(); ++i){
+      counts[i] += other.counts[i];
+    }
+    total += other.total;
+  }
+  std::uint64_t size() const{
+    return total;
+  }
+  // the smallest recorded value (up to the bucket resolution) that is at least the q-quantile, 0 when empty
+  double quantile(double q) const{
+    if(total == 0){
+      return 0.0;
+    }
+    auto rank = std::max<std::uint64_t>(1, std::ceil(q * total));
+    std::uint64_t seen = 0;
+    for(std::size_t i = 0; i < counts.size(); ++i){
+      seen += counts[i];
+      if(seen >= rank){
+        return value_of(i);
+      }
+    }
+    return value_of(counts.size() - 1);
+  }
+};
+
+// the LATENCY_QUANTILES of the merged repeats in nanoseconds and their variance between the repeats
+inline LatencySummary summarize_latency(const std::vector<LatencyHistogram>& repeats){
+  LatencySummary summary;
+  LatencyHistogram merged;
+  for(auto& histogram : repeats){
+    merged.merge(histogram);
+  }
+  double scale = nanoseconds_per_tick();
+  for(std::size_t k = 0; k < LATENCY_QUANTILES.size(); ++k){
+    summary.quantiles[k] = merged.quantile(LATENCY_QUANTILES[k]) * scale;
+    double sum = 0, square_sum = 0;
+    for(auto& histogram : repeats){
+      double value = histogram.quantile(LATENCY_QUANTILES[k]) * scale;
+      sum += value;
+      square_sum += value * value;
+    }
+    double mean = repeats.empty() ? 0.0 : sum / repeats.size();
+    summary.variances[k] = repeats.empty() ? 0.0 : std::max(0.0, square_sum / repeats.size() - mean * mean);
+  }
+  return summary;
+}
+
+// binds the thread to a single core so that repeated runs see the same cache topology
+inline bool pin_thread_to_core(std::thread& thread, unsigned int core){
+#ifdef __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(core % std::thread::hardware_concurrency(), &cpuset);
+  return pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuset) == 0;
+#else
+  return false;
+#endif
+}
+
+// runs f(0), ..., f(num_threads - 1) in parallel, f(0) on the calling thread
+template <typename F>
+void parallel_for(unsigned int num_threads, F f){
+  std::vector<std::thread> threads;
+  for(unsigned int t = 1; t < num_threads; ++t){
+    threads.emplace_back(f, t);
+  }
+  f(0);
+  for(auto& thread : threads){
+    thread.join();
+  }
+}
+
+// calls callback(thread, pos, len) for every key that is text[pos, pos + len) followed by EOW.
+// The text is split into one chunk per thread: a thread owns the start positions in its chunk and
+// follows a match past the end of the chunk, so nothing is lost or reported twice at the boundaries.
+template <typename Dictionary, typename F>
+void scan_text(const Dictionary& dict, std::span<const Char> text, unsigned int num_threads, F callback){
+  parallel_for(num_threads, [&](unsigned int t){
+    std::size_t begin = text.size() * t / num_threads, end = text.size() * (t + 1) / num_threads;
+    for(std::size_t pos = begin; pos < end; ++pos){
+      dict.common_prefix_search(text, pos, [&](std::size_t len){
+        callback(t, pos, len);
+      });
+    }
+  });
+}
+
+// scan_text over the contents of the file at path, read through a shared read-only mapping
+template <typename Dictionary, typename F>
+void scan_corpus(const Dictionary& dict, const std::string& path, unsigned int num_threads, F callback){
+  MappedFile file(path);
+  std::span<const Char> text(reinterpret_cast<const Char*>(file.data()), file.size());
+  scan_text(dict, text, num_threads, callback);
+}
+
+constexpr int CHAR_BITS = 8;
+constexpr int ALPHA = 8;
+inline Index get_lsb_pos(std::uint64_t val){
+  if(val == 0){
+    return ALPHA;
+  }
+  unsigned int ctz = __builtin_ctzll(val);
+  return ctz / CHAR_BITS;
+}
+
+// works on any contiguous containers of Char (String, MappableArray<Char>)
+template <typename S1, typename S2>
+inline Index get_lcp(const S1& str1, Index ofs1, const S2& str2, Index ofs2, Index max_len){
+  unsigned int max_iter = max_len / ALPHA;
+  const Char* ptr1 = str1.data() + ofs1;
+  const Char* ptr2 = str2.data() + ofs2;
+  // the strings are not word aligned, memcpy compiles to a plain unaligned load
+  auto load = [](const Char* ptr){
+    std::uint64_t word;
+    std::memcpy(&word, ptr, sizeof(word));
+    return word;
+  };
+  int i = 0;
+  while(load(ptr1) == load(ptr2) && i < max_iter){
+    ++i;
+    ptr1 += ALPHA;
+    ptr2 += ALPHA;
+  }
+  return std::min(i * ALPHA + get_lsb_pos(load(ptr1) ^ load(ptr2)), max_len);
+}
+
+
+// calls f(begin, end) for every bucket [begin, end) with two or more views after distributing views[first, last)
+// by their character at depth; the views shorter than depth + 1 are moved to the front and are not reported
+template <typename F>
+void radix_pass(StringView* first, StringView* last, std::size_t depth, std::vector<StringView>& buffer, F f){
+  // bucket 0 holds the views that end before depth, bucket c + 1 the views with c at depth
+  std::array<std::size_t, LABEL_RANGE + 2> bucket_begin{};
+  auto bucket = [depth](StringView view) -> std::size_t{
+    return depth < view.size() ? view[depth] + 1 : 0;
+  };
+  for(auto it = first; it != last; ++it){
+    ++bucket_begin[bucket(*it) + 1];
+  }
+  for(std::size_t c = 0; c <= LABEL_RANGE; ++c){
+    bucket_begin[c + 1] += bucket_begin[c];
+  }
+  std::size_t n = last - first;
+  auto largest = std::adjacent_find(bucket_begin.begin(), bucket_begin.end(), [n](std::size_t l, std::size_t r){
+    return r - l == n;
+  });
+  if(largest == bucket_begin.end()){
+    buffer.resize(n);
+    std::array<std::size_t, LABEL_RANGE + 2> pos = bucket_begin;
+    for(auto it = first; it != last; ++it){
+      buffer[pos[bucket(*it)]++] = *it;
+    }
+    std::copy(buffer.begin(), buffer.end(), first);
+  }
+  for(std::size_t c = 1; c <= LABEL_RANGE; ++c){
+    if(bucket_begin[c + 1] - bucket_begin[c] >= 2){
+      f(first + bucket_begin[c], first + bucket_begin[c + 1]);
+    }
+  }
+}
+
+// sorts views[first, last), which share their first depth characters, by MSD radix sort
+inline void msd_radix_sort(StringView* first, StringView* last, std::size_t depth, std::vector<StringView>& buffer){
+  constexpr std::ptrdiff_t INSERTION_THRESHOLD = 32;
+  if(last - first < INSERTION_THRESHOLD){
+    std::sort(first, last, [depth](StringView a, StringView b){
+      return view_less(a.subspan(depth), b.subspan(depth));
+    });
+    return;
+  }
+  radix_pass(first, last, depth, buffer, [&](StringView* begin, StringView* end){
+    msd_radix_sort(begin, end, depth + 1, buffer);
+  });
+}
+
+// sorts the views with num_threads threads: the large buckets are split by radix passes on the calling thread,
+// then the buckets are sorted independently, largest first
+inline void parallel_msd_radix_sort(StringViews& views, unsigned int num_threads){
+  struct Bucket{
+    StringView* first;
+    StringView* last;
+    std::size_t depth;
+  };
+  std::size_t grain = std::max<std::size_t>(views.size() / (8 * num_threads), 1 << 12);
+  std::vector<Bucket> pending{{views.data(), views.data() + views.size(), 0}}, buckets;
+  std::vector<StringView> buffer;
+  while(!pending.empty()){
+    Bucket b = pending.back();
+    pending.pop_back();
+    if(static_cast<std::size_t>(b.last - b.first) <= grain){
+      buckets.emplace_back(b);
+      continue;
+    }
+    radix_pass(b.first, b.last, b.depth, buffer, [&](StringView* begin, StringView* end){
+      pending.push_back({begin, end, b.depth + 1});
+    });
+  }
+  std::sort(buckets.begin(), buckets.end(), [](const Bucket& a, const Bucket& b){
+    return a.last - a.first > b.last - b.first;
+  });
+  std::atomic<std::size_t> next{0};
+  parallel_for(num_threads, [&](unsigned int){
+    std::vector<StringView> local_buffer;
+    for(std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < buckets.size();){
+      msd_radix_sort(buckets[i].first, buckets[i].last, buckets[i].depth, local_buffer);
+    }
+  });
+}
+
+// the lines of a file as keys terminated by EOW, stored in place in one private mapping of the file.
+// Every line terminator is overwritten with EOW; the last line gets its EOW in the zero-filled tail of the mapping.
+class StringPool{
+  Char* arena = nullptr;
+  std::size_t mapped_len = 0;
+  StringViews views;
+public:
+  // reads the lines while their total length stays below length_limit
+  StringPool(const std::string& path, std::size_t length_limit){
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0){
+      throw std::runtime_error("cannot open \"" + path + "\"");
+    }
+    struct stat st{};
+    if(::fstat(fd, &st) != 0){
+      ::close(fd);
+      throw std::runtime_error("cannot stat \"" + path + "\"");
+    }
+    std::size_t file_len = st.st_size;
+    std::size_t page = ::sysconf(_SC_PAGESIZE);
+    // one byte for the last EOW and SECTION_SLACK bytes for the word-wise reads of get_lcp
+    mapped_len = (file_len + 1 + SECTION_SLACK + page - 1) / page * page;
+    void* addr = ::mmap(nullptr, mapped_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(addr != MAP_FAILED && file_len > 0 && ::mmap(addr, file_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED){
+      ::munmap(addr, mapped_len);
+      addr = MAP_FAILED;
+    }
+    ::close(fd);
+    if(addr == MAP_FAILED){
+      throw std::runtime_error("cannot mmap \"" + path + "\"");
+    }
+    arena = static_cast<Char*>(addr);
+    ::madvise(arena, file_len, MADV_SEQUENTIAL);
+    std::size_t total_bytes = 0;
+    for(Char* begin = arena; ; ){
+      auto* end = static_cast<Char*>(std::memchr(begin, '\n', arena + file_len - begin));
+      if(end == nullptr){
+        end = arena + file_len;
+      }
+      total_bytes += end - begin;
+      if(total_bytes >= length_limit){
+        break;
+      }
+      *end = EOW;
+      views.emplace_back(begin, end + 1);
+      if(end == arena + file_len){
+        break;
+      }
+      begin = end + 1;
+    }
+  }
+  StringPool(const StringPool&) = delete;
+  StringPool& operator=(const StringPool&) = delete;
+  StringPool(StringPool&& other) noexcept : arena(std::exchange(other.arena, nullptr)), mapped_len(std::exchange(other.mapped_len, 0)), views(std::move(other.views)){}
+  ~StringPool(){
+    if(arena != nullptr){
+      ::munmap(arena, mapped_len);
+    }
+  }
+  // sorts the keys and removes the duplicates
+  void sort_unique(unsigned int num_threads){
+    parallel_msd_radix_sort(views, num_threads);
+    views.erase(std::unique(views.begin(), views.end(), [](StringView a, StringView b){
+      return std::ranges::equal(a, b);
+    }), views.end());
+  }
+  const StringViews& keys() const{
+    return views;
+  }
+  std::size_t size() const{
+    return views.size();
+  }
+  std::size_t total_bytes() const{
+    return std::accumulate(views.begin(), views.end(), std::size_t(0), [](std::size_t sum, StringView line){
+      return sum + line.size();
+    });
+  }
+};
+
+StringPool load_dataset(const std::string& dataset_name, std::size_t length_limit){
+  std::string data_path = data_dir_path + dataset_name;
+  std::clog << "loading: " << data_path << std::endl;
+  StringPool pool(data_path, length_limit);
+  std::vector<bool> occur(256, false);
+  for(StringView line : pool.keys()){
+    for(auto c : line){
+      occur[c] = true;
+    }
+  }
+  std::clog << "Loading file \"" << data_path << "\" is finished." << std::endl;
+  std::clog << "Number of lines (bef): " << pool.size() << std::endl;
+  std::clog << "Total bytes     (bef): " << pool.total_bytes() - pool.size() << std::endl;
+  pool.sort_unique(std::max(std::thread::hardware_concurrency(), 1u));
+  std::size_t total_bytes = pool.total_bytes();
+  std::clog << "Number of lines      : " << pool.size() << std::endl;
+  std::clog << "Total bytes          : " << total_bytes << std::endl;
+  std::clog << "Number of characters : " << std::count(occur.begin(), occur.end(), true) << std::endl;
+  std::clog << "Average length       : " << 1.0 * total_bytes / pool.size() << std::endl;
+  std::clog << std::endl;
+  return pool;
+}
+
+// splits the distinct keys by a random permutation: the first n * A_ratio keys go to A, the rest to B
+std::pair<StringViews, StringViews> split_data(const StringViews& data, std::uint64_t seed = 42, double A_ratio = 0.8){
+  std::vector<std::size_t> perm(data.size());
+  std::iota(perm.begin(), perm.end(), 0);
+  std::mt19937 rand(seed);
+  std::shuffle(perm.begin(), perm.end(), rand);
+  std::size_t train_size = data.size() * A_ratio;
+  StringViews A, B;
+  A.reserve(train_size);
+  B.reserve(data.size() - train_size);
+  for(std::size_t i = 0; i < perm.size(); ++i){
+    (i < train_size ? A : B).emplace_back(data[perm[i]]);
+  }
+  return {A, B};
+}
+
+// an edge (label, child) of a state signature packed into one word
+inline std::uint64_t pack_edge(Char key, Index to){
+  return (static_cast<std::uint64_t>(static_cast<std::make_unsigned_t<Index>>(to)) << CHAR_BITS) | key;
+}
+
+inline std::uint64_t hash_signature(std::span<const std::uint64_t> signature){
+  std::uint64_t hash = 0x9e3779b97f4a7c15ull ^ signature.size();
+  for(auto word : signature){
+    hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+    hash ^= hash >> 32;
+  }
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  return hash ^ (hash >> 29);
+}
+
+// a register of automaton states keyed by their signature (the sorted list of packed edges).
+// The signatures are stored back to back and looked up through an open-addressing table of state ids.
+class StateRegistry{
+  std::vector<std::uint64_t> words;
+  std::vector<std::size_t> offsets{0};
+  std::vector<std::uint64_t> hashes;
+  std::vector<Index> slots;
+  std::size_t mask = 0;
+  void rehash(std::size_t capacity){
+    slots.assign(capacity, NOT_FOUND);
+    mask = capacity - 1;
+    for(Index id = 0; id < size(); ++id){
+      std::size_t pos = hashes[id] & mask;
+      while(slots[pos] != NOT_FOUND){
+        pos = (pos + 1) & mask;
+      }
+      slots[pos] = id;
+    }
+  }
+public:
+  explicit StateRegistry(std::size_t expected_size = 0){
+    std::size_t capacity = 16;
+    while(capacity < expected_size * 2){
+      capacity <<= 1;
+    }
+    rehash(capacity);
+  }
+  // returns the id of the state with the given signature and whether it has just been registered
+  std::pair<Index, bool> find_or_insert(std::span<const std::uint64_t> signature, std::uint64_t hash){
+    std::size_t pos = hash & mask;
+    while(slots[pos] != NOT_FOUND){
+      Index id = slots[pos];
+      if(hashes[id] == hash && std::ranges::equal(this->signature(id), signature)){
+        return {id, false};
+      }
+      pos = (pos + 1) & mask;
+    }
+    Index id = size();
+    slots[pos] = id;
+    hashes.emplace_back(hash);
+    words.insert(words.end(), signature.begin(), signature.end());
+    offsets.emplace_back(words.size());
+    if(hashes.size() * 2 > slots.size()){
+      rehash(slots.size() * 2);
+    }
+    return {id, true};
+  }
+  std::pair<Index, bool> find_or_insert(std::span<const std::uint64_t> signature){
+    return find_or_insert(signature, hash_signature(signature));
+  }
+  std::span<const std::uint64_t> signature(Index id) const{
+    return {words.data() + offsets[id], words.data() + offsets[id + 1]};
+  }
+  Index size() const{
+    return hashes.size();
+  }
+};
+
+// the transitions of all nodes: search(idx, key) returns the child of idx labeled key, or NOT_FOUND.
+// The indexes hold their maps by value, so the transition of the search loop is resolved (and inlined) at compile time.
+template <typename T>
+concept TransitionMaps = requires(const T& maps, Index idx, Char key){
+  { maps.search(idx, key) } -> std::convertible_to<Index>;
+};
+
+// the transitions of a single node
+template <typename T>
+concept TransitionMap = std::default_initializable<T> && requires(T& map, const T& cmap, Char key, Index val){
+  map.insert(key, val);
+  { cmap.search(key) } -> std::convertible_to<Index>;
+  { cmap.to_vector() } -> std::convertible_to<std::vector<std::pair<Char, Index>>>;
+};
+
+class STLMap{
+  std::map<Char, Index> map;
+public:
+  void insert(Char key, Index val){
+    assert(map.find(key) == map.end());
+    map[key] = val;
+  }
+  Index search(Char key) const{
+    auto it = map.find(key);
+    if(it == map.end()){
+      return NOT_FOUND;
+    }
+    return it->second;
+  }
+  std::size_t outdegree() const{
+    return map.size();
+  }
+  // heap bytes of the tree nodes: a color and three links besides the edge, in 16-byte malloc chunks
+  std::size_t memory_usage() const{
+    constexpr std::size_t node_bytes = (sizeof(int) + 3 * sizeof(void*) + sizeof(std::pair<const Char, Index>) + 15) / 16 * 16;
+    return map.size() * node_bytes;
+  }
+  // calls f(key, val) in ascending key order
+  template <typename F>
+  void for_each(F&& f) const{
+    for(auto [key, val] : map){
+      f(key, val);
+    }
+  }
+  std::vector<std::pair<Char, Index>> to_vector() const{
+    std::vector<std::pair<Char, Index>> data(map.begin(), map.end());
+    return data;
+  }
+};
+
+template <TransitionMap T>
+class MapVector{
+  std::vector<T> maps;
+public:
+  explicit MapVector(Index size){
+    maps.resize(size);
+  }
+  void insert(Index idx, Char key, Index val){
+    maps[idx].insert(key, val);
+  }
+  Index search(Index idx, Char key) const{
+    return maps[idx].search(key);
+  }
+  std::size_t outdegree(Index idx) const{
+    return maps[idx].outdegree();
+  }
+  // calls f(key, val) for the edges of idx in ascending key order
+  template <typename F>
+  void for_each_child(Index idx, F&& f) const{
+    maps[idx].for_each(f);
+  }
+  void extend(Index size){
+    maps.resize(size);
+  }
+  Index size() const{
+    return maps.size();
+  }
+  std::size_t memory_usage() const{
+    std::size_t memory = maps.capacity() * sizeof(T);
+    for(auto& map : maps){
+      memory += map.memory_usage();
+    }
+    return memory;
+  }
+  std::vector<std::vector<std::pair<Char, Index>>> to_vector() const{
+    std::vector<std::vector<std::pair<Char, Index>>> data(maps.size());
+    for(Index i = 0; i < maps.size(); ++i){
+      data[i] = maps[i].to_vector();
+    }
+    return data;
+  }
+};
+
+enum class DoubleArrayPlacement{
+  // scans the bases upwards one cell at a time, nodes in index order
+  Linear,
+  // places the nodes by descending fanout, skips to the next empty cell through the occupancy bitmap and tests 64 bases
+  // at once against it. Denser than Linear, but slower to build except on wide alphabets
+  FreeList,
+};
+
+// cell layouts of DoubleArrayMaps. A layout is built from the plain next/check arrays and answers
+// search(base, key) for the cell base + key; cells whose check is NULL_CHAR are empty.
+
+// next and check in two parallel arrays: 5 bytes per cell (6 and 9 with 40/64-bit indexes), but a transition touches two cache lines
+class SplitCells{
+  MappableArray<StoredIndex> next;
+  MappableArray<Char> check;
+public:
+  static constexpr const char* name = "Split";
+  SplitCells() = default;
+  SplitCells(const std::vector<Index>& next, std::vector<Char> check) : next(next), check(std::move(check)){}
+  Index search(Index idx, Char key) const{
+    if(check[idx] == key){
+      return next[idx];
+    }
+    return NOT_FOUND;
+  }
+  Char check_at(Index idx) const{
+    return check[idx];
+  }
+  void prefetch(Index idx) const{
+    __builtin_prefetch(check.data() + idx);
+    __builtin_prefetch(next.data() + idx);
+  }
+  std::size_t size() const{
+    return next.size();
+  }
+  std::size_t memory_usage() const{
+    return (sizeof(Char) + sizeof(StoredIndex)) * size();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.next, self.check);
+  }
+};
+
+// next (24 bits) and check (8 bits) packed into one 32-bit word: 4 bytes per cell and one load per transition.
+// TAIL_FLAG moves to bit 23, so targets and tail offsets must be below 2^23.
+class PackedCells{
+  static constexpr std::uint32_t NEXT_BITS = 24;
+  static constexpr std::uint32_t PACKED_TAIL_FLAG = 1u << (NEXT_BITS - 1);
+  MappableArray<std::uint32_t> words;
+public:
+  static constexpr const char* name = "Packed";
+  PackedCells() = default;
+  PackedCells(const std::vector<Index>& next, const std::vector<Char>& check){
+    std::vector<std::uint32_t> packed(next.size(), 0);
+    for(std::size_t i = 0; i < next.size(); ++i){
+      if(check[i] == NULL_CHAR){
+        continue;
+      }
+      Index to = next[i];
+      Index target = to & ~TAIL_FLAG;
+      if(target >= PACKED_TAIL_FLAG){
+        throw std::overflow_error("PackedCells: target " + std::to_string(target) + " does not fit in " + std::to_string(NEXT_BITS - 1) + " bits");
+      }
+      std::uint32_t val = target;
+      if(to & TAIL_FLAG){
+        val |= PACKED_TAIL_FLAG;
+      }
+      packed[i] = (val << 8) | check[i];
+    }
+    words = std::move(packed);
+  }
+  Index search(Index idx, Char key) const{
+    std::uint32_t word = words[idx];
+    if((word & 0xFF) != key){
+      return NOT_FOUND;
+    }
+    std::uint32_t val = word >> 8;
+    return static_cast<Index>(val & (PACKED_TAIL_FLAG - 1)) | (static_cast<Index>(val & PACKED_TAIL_FLAG) << (INDEX_BITS - NEXT_BITS));
+  }
+  Char check_at(Index idx) const{
+    return words[idx] & 0xFF;
+  }
+  void prefetch(Index idx) const{
+    __builtin_prefetch(words.data() + idx);
+  }
+  std::size_t size() const{
+    return words.size();
+  }
+  std::size_t memory_usage() const{
+    return sizeof(std::uint32_t) * size();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.words);
+  }
+};
+
+struct InterleavedCell{
+  StoredIndex next;
+  Char check;
+};
+
+// next and check side by side in an 8-byte struct (6 and 16 bytes with 40/64-bit indexes): one load per transition without limiting the targets
+class InterleavedCells{
+  MappableArray<InterleavedCell> cells;
+public:
+  static constexpr const char* name = "Interleaved";
+  InterleavedCells() = default;
+  InterleavedCells(const std::vector<Index>& next, const std::vector<Char>& check){
+    std::vector<InterleavedCell> vec(next.size());
+    for(std::size_t i = 0; i < next.size(); ++i){
+      vec[i] = {next[i], check[i]};
+    }
+    cells = std::move(vec);
+  }
+  Index search(Index idx, Char key) const{
+    const InterleavedCell& cell = cells[idx];
+    if(cell.check == key){
+      return cell.next;
+    }
+    return NOT_FOUND;
+  }
+  Char check_at(Index idx) const{
+    return cells[idx].check;
+  }
+  void prefetch(Index idx) const{
+    __builtin_prefetch(cells.data() + idx);
+  }
+  std::size_t size() const{
+    return cells.size();
+  }
+  std::size_t memory_usage() const{
+    return sizeof(InterleavedCell) * size();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.cells);
+  }
+};
+
+// unsigned values of up to 57 bits stored back to back at the width of the largest one.
+// A value is one unaligned 64-bit load, a shift and a mask; the words are padded so that the load stays inside.
+class BitPackedArray{
+  static constexpr std::uint64_t MAX_WIDTH = 57;
+  MappableArray<std::uint64_t> words;
+  std::uint64_t len = 0;
+  std::uint64_t width = 1;
+  std::uint64_t mask = 1;
+  // the 64 bits starting at bit `bit`, little endian
+  std::uint64_t bits_at(std::size_t bit) const{
+    std::uint64_t word;
+    std::memcpy(&word, reinterpret_cast<const char*>(words.data()) + bit / 8, sizeof(word));
+    return word >> (bit % 8);
+  }
+public:
+  BitPackedArray() = default;
+  template <typename T> requires std::is_integral_v<T>
+  BitPackedArray(const std::vector<T>& vals) : len(vals.size()){
+    std::uint64_t max_val = 0;
+    for(T val : vals){
+      assert(static_cast<std::int64_t>(val) >= 0);
+      max_val = std::max<std::uint64_t>(max_val, val);
+    }
+    width = std::max<std::uint64_t>(1, std::bit_width(max_val));
+    if(width > MAX_WIDTH){
+      throw std::overflow_error("BitPackedArray: value " + std::to_string(max_val) + " does not fit in " + std::to_string(MAX_WIDTH) + " bits");
+    }
+    mask = (1ull << width) - 1;
+    // two words of padding: fields_at reads up to 8 fields of 7 bits past the last value
+    std::vector<std::uint64_t> packed((len * width + 63) / 64 + 2, 0);
+    for(std::size_t i = 0; i < len; ++i){
+      std::size_t bit = i * width;
+      std::uint64_t val = vals[i];
+      packed[bit / 64] |= val << (bit % 64);
+      if(bit % 64 + width > 64){
+        packed[bit / 64 + 1] |= val >> (64 - bit % 64);
+      }
+    }
+    words = std::move(packed);
+  }
+  std::uint64_t operator[](std::size_t i) const{
+    return bits_at(i * width) & mask;
+  }
+  // `count` consecutive values from i on, the first in the lowest bits; count * width must not exceed MAX_WIDTH
+  std::uint64_t fields_at(std::size_t i, std::uint64_t count) const{
+    return bits_at(i * width) & ((1ull << (count * width)) - 1);
+  }
+  void prefetch(std::size_t i) const{
+    __builtin_prefetch(reinterpret_cast<const char*>(words.data()) + i * width / 8);
+  }
+  std::uint64_t bit_width() const{
+    return width;
+  }
+  std::size_t size() const{
+    return len;
+  }
+  std::size_t memory_usage() const{
+    return sizeof(std::uint64_t) * words.size();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.words, self.len, self.width, self.mask);
+  }
+};
+
+// a string stored at the width of its alphabet (NULL_CHAR and EOW included): 5 bits per character for 25 distinct ones.
+// get_lcp decodes 8 characters at a time into the word a plain string would hold, so it compares whole words as before.
+class PackedString{
+  BitPackedArray codes;
+  // the character of every code, padded to a power of two so that any field decodes
+  MappableArray<Char> alphabet;
+public:
+  PackedString() = default;
+  PackedString(StringView str){
+    std::array<bool, LABEL_RANGE> used{};
+    used[NULL_CHAR] = true;
+    for(Char c : str){
+      used[c] = true;
+    }
+    std::vector<Char> decode;
+    std::array<Char, LABEL_RANGE> encode{};
+    for(Index c = 0; c < LABEL_RANGE; ++c){
+      if(used[c]){
+        encode[c] = decode.size();
+        decode.emplace_back(c);
+      }
+    }
+    std::vector<Char> encoded(str.size());
+    for(std::size_t i = 0; i < str.size(); ++i){
+      encoded[i] = encode[str[i]];
+    }
+    // NULL_CHAR has code 0, so the zero padding after the last character decodes to NULL_CHAR
+    codes = BitPackedArray(encoded);
+    decode.resize(std::size_t(1) << codes.bit_width(), NULL_CHAR);
+    alphabet = std::move(decode);
+  }
+  Char operator[](std::size_t i) const{
+    return alphabet[codes[i]];
+  }
+  // the characters [pos, pos + 8) in the byte order of a plain string
+  std::uint64_t word_at(std::size_t pos) const{
+    std::uint64_t word = 0;
+    std::uint64_t width = codes.bit_width();
+    std::uint64_t mask = (1ull << width) - 1;
+    for(std::size_t half = 0; half < 2; ++half){
+      std::uint64_t fields = codes.fields_at(pos + 4 * half, 4);
+      for(std::size_t k = 0; k < 4; ++k){
+        word |= static_cast<std::uint64_t>(alphabet[(fields >> (k * width)) & mask]) << (CHAR_BITS * (4 * half + k));
+      }
+    }
+    return word;
+  }
+  std::size_t size() const{
+    return codes.size();
+  }
+  std::size_t memory_usage() const{
+    return codes.memory_usage() + sizeof(Char) * alphabet.size();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.codes, self.alphabet);
+  }
+};
+
+// get_lcp on a PackedString, a word of decoded characters at a time
+template <typename S2>
+inline Index get_lcp(const PackedString& str1, Index ofs1, const S2& str2, Index ofs2, Index max_len){
+  const Char* ptr2 = str2.data() + ofs2;
+  for(Index i = 0; ; i += ALPHA){
+    std::uint64_t word2;
+    std::memcpy(&word2, ptr2 + i, sizeof(word2));
+    std::uint64_t diff = str1.word_at(ofs1 + i) ^ word2;
+    if(diff != 0 || i + ALPHA > max_len){
+      return std::min(i + get_lsb_pos(diff), max_len);
+    }
+  }
+}
+
+// next and check bit-packed into one field per cell: the width of the largest target (plus the tail flag if a target has it)
+// and 8 bits of check, e.g. 28 bits for 2^20 nodes. A transition is one unaligned load and a branch-free select.
+class BitPackedCells{
+  BitPackedArray cells;
+  // the tail flag inside the next part of a field, 0 if no target has it
+  std::uint64_t tail_flag = 0;
+public:
+  static constexpr const char* name = "BitPacked";
+  BitPackedCells() = default;
+  BitPackedCells(const std::vector<Index>& next, const std::vector<Char>& check){
+    std::uint64_t max_val = 0;
+    bool has_tail = false;
+    for(std::size_t i = 0; i < next.size(); ++i){
+      if(check[i] != NULL_CHAR){
+        Index to = next[i];
+        has_tail |= (to & TAIL_FLAG) != 0;
+        max_val = std::max<std::uint64_t>(max_val, to & ~TAIL_FLAG);
+      }
+    }
+    tail_flag = has_tail ? 1ull << std::bit_width(max_val) : 0;
+    std::vector<std::uint64_t> packed(next.size(), 0);
+    for(std::size_t i = 0; i < next.size(); ++i){
+      if(check[i] != NULL_CHAR){
+        Index to = next[i];
+        std::uint64_t val = static_cast<std::uint64_t>(to & ~TAIL_FLAG) | ((to & TAIL_FLAG) ? tail_flag : 0);
+        packed[i] = (val << CHAR_BITS) | check[i];
+      }
+    }
+    cells = BitPackedArray(packed);
+  }
+  Index search(Index idx, Char key) const{
+    std::uint64_t cell = cells[idx];
+    std::uint64_t val = cell >> CHAR_BITS;
+    Index to = static_cast<Index>(val & ~tail_flag) | (static_cast<Index>((val & tail_flag) != 0) << (INDEX_BITS - 1));
+    return (cell & 0xFF) == key ? to : NOT_FOUND;
+  }
+  Char check_at(Index idx) const{
+    return cells[idx] & 0xFF;
+  }
+  void prefetch(Index idx) const{
+    cells.prefetch(idx);
+  }
+  std::size_t size() const{
+    return cells.size();
+  }
+  std::size_t memory_usage() const{
+    return cells.memory_usage();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.cells, self.tail_flag);
+  }
+};
+
+// a read-only bit vector (is_leaf) in 64-bit words, so that it is used straight from a mapping
+class MappableBits{
+  MappableArray<std::uint64_t> words;
+  std::uint64_t len = 0;
+public:
+  MappableBits() = default;
+  // from any bit container with size() and operator[] (std::vector<bool>, sdsl::bit_vector)
+  template <typename Bits> requires (!std::is_same_v<Bits, MappableBits>)
+  explicit MappableBits(const Bits& vals) : len(vals.size()){
+    std::vector<std::uint64_t> packed((len + 63) / 64, 0);
+    for(std::size_t i = 0; i < len; ++i){
+      packed[i / 64] |= static_cast<std::uint64_t>(vals[i] ? 1 : 0) << (i % 64);
+    }
+    words = std::move(packed);
+  }
+  bool operator[](std::size_t i) const{
+    return (words[i / 64] >> (i % 64)) & 1;
+  }
+  std::size_t size() const{
+    return len;
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.words, self.len);
+  }
+};
+
+// the position of the one of rank r (from 0) in word
+inline unsigned int select_in_word(std::uint64_t word, unsigned int r){
+#if defined(__BMI2__)
+  return __builtin_ctzll(_pdep_u64(1ull << r, word));
+#else
+  for(; r > 0; --r){
+    word &= word - 1;
+  }
+  return __builtin_ctzll(word);
+#endif
+}
+
+// a bit vector with the number of ones before every 256-bit block, 12.5% on top of the bits
+class RankedBits{
+  static constexpr std::size_t BLOCK_WORDS = 4;
+  MappableArray<std::uint64_t> bits;
+  MappableArray<std::uint32_t> block_ranks;
+public:
+  RankedBits() = default;
+  explicit RankedBits(const std::vector<bool>& vals){
+    std::vector<std::uint64_t> words((vals.size() + 63) / 64 + 1, 0);
+    for(std::size_t i = 0; i < vals.size(); ++i){
+      words[i / 64] |= static_cast<std::uint64_t>(vals[i]) << (i % 64);
+    }
+    std::vector<std::uint32_t> ranks(words.size() / BLOCK_WORDS + 1, 0);
+    std::uint32_t sum = 0;
+    for(std::size_t w = 0; w < words.size(); ++w){
+      if(w % BLOCK_WORDS == 0){
+        ranks[w / BLOCK_WORDS] = sum;
+      }
+      sum += std::popcount(words[w]);
+    }
+    bits = std::move(words);
+    block_ranks = std::move(ranks);
+  }
+  bool operator[](std::size_t i) const{
+    return (bits[i / 64] >> (i % 64)) & 1;
+  }
+  // the number of ones before position i
+  Index rank(std::size_t i) const{
+    std::size_t word = i / 64;
+    Index r = block_ranks[word / BLOCK_WORDS];
+    for(std::size_t w = word / BLOCK_WORDS * BLOCK_WORDS; w < word; ++w){
+      r += std::popcount(bits[w]);
+    }
+    return r + std::popcount(bits[word] & ((1ull << (i % 64)) - 1));
+  }
+  std::size_t memory_usage() const{
+    return sizeof(std::uint64_t) * bits.size() + sizeof(std::uint32_t) * block_ranks.size();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.bits, self.block_ranks);
+  }
+};
+
+// next stored as next XOR the index of the cell, which is small when a target is placed near the edge to it
+// (compressed double arrays), in tiers as directly addressable codes: the low 8 bits share a 16-bit word with check,
+// bits 8..15 of the cells that need them follow in a second tier and bits 16..31 in a third, each found by a rank.
+// TAIL_FLAG is kept in bit 31, so with 40/64-bit indexes the targets and the cell indices must be below 2^31.
+class XorCells{
+  // check in the low byte, bits 0..7 of next XOR idx in the high byte
+  MappableArray<std::uint16_t> cells;
+  // the cells (resp. second tier entries) that continue in the next tier
+  RankedBits extends1, extends2;
+  MappableArray<Char> tier1;
+  MappableArray<std::uint16_t> tier2;
+public:
+  static constexpr const char* name = "Xor";
+  XorCells() = default;
+  XorCells(const std::vector<Index>& next, const std::vector<Char>& check){
+    std::vector<std::uint16_t> vec(next.size(), 0);
+    std::vector<bool> ext1(next.size(), false), ext2;
+    std::vector<Char> t1;
+    std::vector<std::uint16_t> t2;
+    for(std::size_t i = 0; i < next.size(); ++i){
+      if(check[i] == NULL_CHAR){
+        continue;
+      }
+      Index to = next[i];
+      if((to & ~TAIL_FLAG) > INT32_MAX || i > INT32_MAX){
+        throw std::overflow_error("XorCells: target " + std::to_string(to & ~TAIL_FLAG) + " of cell " + std::to_string(i) + " does not fit in 31 bits");
+      }
+      std::uint32_t target = static_cast<std::uint32_t>(to & ~TAIL_FLAG) | ((to & TAIL_FLAG) ? 1u << 31 : 0);
+      std::uint32_t x = target ^ static_cast<std::uint32_t>(i);
+      vec[i] = ((x & 0xFF) << CHAR_BITS) | check[i];
+      if(x >> 8){
+        ext1[i] = true;
+        t1.emplace_back((x >> 8) & 0xFF);
+        ext2.emplace_back((x >> 16) != 0);
+        if(x >> 16){
+          t2.emplace_back(x >> 16);
+        }
+      }
+    }
+    cells = std::move(vec);
+    extends1 = RankedBits(ext1);
+    extends2 = RankedBits(ext2);
+    tier1 = std::move(t1);
+    tier2 = std::move(t2);
+  }
+  Index search(Index idx, Char key) const{
+    std::uint16_t cell = cells[idx];
+    if((cell & 0xFF) != key){
+      return NOT_FOUND;
+    }
+    std::uint32_t x = cell >> CHAR_BITS;
+    if(extends1[idx]){
+      Index r = extends1.rank(idx);
+      x |= static_cast<std::uint32_t>(tier1[r]) << 8;
+      if(extends2[r]){
+        x |= static_cast<std::uint32_t>(tier2[extends2.rank(r)]) << 16;
+      }
+    }
+    std::uint32_t target = x ^ static_cast<std::uint32_t>(idx);
+    return static_cast<Index>(target & INT32_MAX) | (static_cast<Index>(target >> 31) << (INDEX_BITS - 1));
+  }
+  Char check_at(Index idx) const{
+    return cells[idx] & 0xFF;
+  }
+  void prefetch(Index idx) const{
+    __builtin_prefetch(cells.data() + idx);
+  }
+  std::size_t size() const{
+    return cells.size();
+  }
+  // the number of cells whose next needs one and two overflow tiers
+  std::pair<std::size_t, std::size_t> tier_sizes() const{
+    return {tier1.size(), tier2.size()};
+  }
+  std::size_t memory_usage() const{
+    return sizeof(std::uint16_t) * cells.size() + extends1.memory_usage() + extends2.memory_usage()
+           + sizeof(Char) * tier1.size() + sizeof(std::uint16_t) * tier2.size();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.cells, self.extends1, self.extends2, self.tier1, self.tier2);
+  }
+};
+
+// the arrays a double-array index keeps besides its cells: per node (bases) and per character (heavy_str, tail_str).
+// BitPackedCells packs them as well.
+template <typename Cells>
+struct DoubleArrayStorage{
+  using IndexArray = MappableArray<StoredIndex>;
+  using CharArray = MappableArray<Char>;
+};
+template <>
+struct DoubleArrayStorage<BitPackedCells>{
+  using IndexArray = BitPackedArray;
+  using CharArray = PackedString;
+};
+
+template <typename T>
+std::size_t array_memory_usage(const MappableArray<T>& arr){
+  return sizeof(T) * arr.size();
+}
+inline std::size_t array_memory_usage(const BitPackedArray& arr){
+  return arr.memory_usage();
+}
+inline std::size_t array_memory_usage(const PackedString& str){
+  return str.memory_usage();
+}
+template <typename T>
+void prefetch_element(const MappableArray<T>& arr, std::size_t i){
+  __builtin_prefetch(arr.data() + i);
+}
+inline void prefetch_element(const BitPackedArray& arr, std::size_t i){
+  arr.prefetch(i);
+}
+
+// ByteCodes: every byte is its own code, fixed at compile time, so the transitions skip the code table
+template <typename Cells = SplitCells, bool ByteCodes = false>
+class DoubleArrayMaps{
+  // grows the arrays under construction so that they have at least `size` cells
+  static void extend(std::vector<Index>& next, std::vector<Char>& check, std::size_t size){
+    next.resize(size, NOT_FOUND);
+    check.resize(size, NULL_CHAR);
+  }
+  // fills check and returns the base of every node. Bases are distinct, and the arrays cover
+  // `range` cells (every code) after every base, otherwise search(base, key) would read past the end.
+  static std::vector<Index> place_linear(const std::vector<std::vector<std::pair<Char, Index>>>& data, Index range, std::vector<Index>& next, std::vector<Char>& check){
+    std::vector<Index> curs(data.size(), 0);
+    extend(next, check, data.size());
+    Index cur = 0;
+    for(Index i = 0; i < data.size(); ++i){
+      for(; ; ++cur){
+        bool ok = true;
+        for(auto [key, to] : data[i]){
+          if(cur + key >= next.size()){
+            extend(next, check, cur + key + 1);
+          }
+          else if(check[cur + key] != NULL_CHAR){
+            ok = false;
+            break;
+          }
+        }
+        if(ok){
+          break;
+        }
+      }
+      for(auto [key, to] : data[i]){
+        check[cur + key] = key;
+      }
+      curs[i] = cur;
+      ++cur;
+    }
+    extend(next, check, std::max<std::size_t>(next.size(), cur + range));
+    return curs;
+  }
+  // nodes without edges may share one base unless the base identifies the node (distinct_empty_bases).
+  // The root gets base 0, then the nodes are placed by descending fanout: the wide nodes while the array is still sparse,
+  // then the nodes with one edge (in index order) in the gaps they leave, then the nodes without edges
+  static std::vector<Index> place_free_list(const std::vector<std::vector<std::pair<Char, Index>>>& data, Index range, bool distinct_empty_bases, std::vector<Index>& next, std::vector<Char>& check){
+    std::vector<Index> curs(data.size(), NOT_FOUND);
+    // the free list is the zero bits of occupied
+    std::vector<std::uint64_t> occupied, base_used;
+    auto grow = [&](std::size_t size){
+      if(size <= check.size()){
+        return;
+      }
+      // whole blocks of cells, so that the arrays are not resized for almost every node; the end is trimmed below
+      size = (size / 4096 + 1) * 4096;
+      extend(next, check, size);
+      occupied.resize(size / 64 + 2, 0);
+      base_used.resize(size / 64 + 2, 0);
+    };
+    auto set_bit = [](std::vector<std::uint64_t>& bits, std::size_t pos){
+      bits[pos / 64] |= 1ull << (pos % 64);
+    };
+    // 64 bits starting at position pos
+    auto bits_at = [](const std::vector<std::uint64_t>& bits, std::size_t pos){
+      std::size_t w = pos / 64, o = pos % 64;
+      return o == 0 ? bits[w] : (bits[w] >> o) | (bits[w + 1] << (64 - o));
+    };
+    // the first zero bit at or after pos; the positions past the bitmap are all zero
+    auto next_zero = [](const std::vector<std::uint64_t>& bits, Index pos){
+      std::size_t w = pos / 64;
+      if(w >= bits.size()){
+        return pos;
+      }
+      std::uint64_t zeros = ~bits[w] & (~0ull << (pos % 64));
+      while(zeros == 0){
+        if(++w == bits.size()){
+          return static_cast<Index>(w * 64);
+        }
+        zeros = ~bits[w];
+      }
+      return static_cast<Index>(w * 64 + __builtin_ctzll(zeros));
+    };
+    Index max_base = 0;
+    auto put = [&](Index i, Index base){
+      grow(base + range);
+      curs[i] = base;
+      set_bit(base_used, base);
+      max_base = std::max(max_base, base);
+      for(auto [key, to] : data[i]){
+        Index cell = base + key;
+        check[cell] = key;
+        set_bit(occupied, cell);
+      }
+    };
+    // the scan of a fanout starts at the first free cell, and every node resumes it where the previous one found its base,
+    // since the cells before failed for this fanout already (a rolling cursor)
+    Index cursor = 0;
+    auto place_node = [&](Index i){
+      Index first = range;
+      for(auto [key, to] : data[i]){
+        first = std::min<Index>(first, key);
+      }
+      Index c = next_zero(occupied, std::max(cursor, first));
+      while(true){
+        // tests the 64 bases [window, window + 64) at once: bit j survives iff base window + j is
+        // unused and all its cells are empty
+        Index window = c - first;
+        grow(window + 64 + range);
+        std::uint64_t candidates = ~bits_at(base_used, window);
+        for(auto [key, to] : data[i]){
+          candidates &= ~bits_at(occupied, window + key);
+          if(candidates == 0){
+            break;
+          }
+        }
+        if(candidates != 0){
+          cursor = c;
+          put(i, window + __builtin_ctzll(candidates));
+          return;
+        }
+        // no base in the window works
+        c = next_zero(occupied, c + 64);
+      }
+    };
+
+    std::vector<std::uint16_t> fanouts(data.size());
+    // the nodes with two or more edges by descending fanout (ties in index order), by a counting sort
+    std::vector<Index> start(LABEL_RANGE + 2, 0);
+    std::size_t edges = 0;
+    for(Index i = 0; i < data.size(); ++i){
+      fanouts[i] = data[i].size();
+      edges += fanouts[i];
+      if(i != 0 && fanouts[i] >= 2){
+        ++start[LABEL_RANGE - fanouts[i] + 1];
+      }
+    }
+    // the cells fill up densely, so the arrays start a little larger than the number of edges
+    grow(edges + edges / 8 + range);
+    std::partial_sum(start.begin(), start.end(), start.begin());
+    std::vector<Index> wide(start.back());
+    for(Index i = 1; i < data.size(); ++i){
+      if(fanouts[i] >= 2){
+        wide[start[LABEL_RANGE - fanouts[i]]++] = i;
+      }
+    }
+    if(!data.empty() && fanouts[0] != 0){
+      put(0, 0);
+    }
+    for(Index k = 0; k < wide.size(); ++k){
+      // the cells that failed the wider nodes may fit the narrower ones
+      if(k == 0 || fanouts[wide[k]] != fanouts[wide[k - 1]]){
+        cursor = 0;
+      }
+      place_node(wide[k]);
+    }
+    cursor = 0;
+    for(Index i = 1; i < data.size(); ++i){
+      if(fanouts[i] == 1){
+        place_node(i);
+      }
+    }
+    // a node without edges only needs a base that no node with edges uses
+    Index empty_base = NOT_FOUND;
+    for(Index i = 0; i < data.size(); ++i){
+      if(fanouts[i] != 0){
+        continue;
+      }
+      if(empty_base == NOT_FOUND || distinct_empty_bases){
+        empty_base = next_zero(base_used, empty_base == NOT_FOUND ? 0 : empty_base + 1);
+        put(i, empty_base);
+      }
+      else{
+        curs[i] = empty_base;
+      }
+    }
+    std::size_t used_size = check.size();
+    while(used_size > 0 && check[used_size - 1] == NULL_CHAR){
+      --used_size;
+    }
+    std::size_t size = std::max<std::size_t>(used_size, max_base + range);
+    next.resize(size);
+    check.resize(size);
+    return curs;
+  }
+  static std::vector<Index> place(const std::vector<std::vector<std::pair<Char, Index>>>& data, Index range, DoubleArrayPlacement placement, bool distinct_empty_bases, std::vector<Index>& next, std::vector<Char>& check){
+    if(placement == DoubleArrayPlacement::Linear){
+      return place_linear(data, range, next, check);
+    }
+    return place_free_list(data, range, distinct_empty_bases, next, check);
+  }
+  Cells cells;
+  // the code of every byte; the cells are addressed and checked by codes
+  MappableArray<Char> codes;
+  Char code(Char key) const{
+    if constexpr(ByteCodes){
+      return key;
+    }
+    else{
+      return codes[key];
+    }
+  }
+  // dense alphabet: the σ labels get the codes 1, 2, ..., σ in descending number of edges, so the children of a node
+  // spread over σ + 2 cells instead of 256 and the frequent labels of different nodes interleave less.
+  // Bytes that are no label get σ + 1, a code that no cell checks (NULL_CHAR stays the check of the empty cells).
+  // Without dense_alphabet, or with 255 labels, every byte is its own code. Rewrites the keys of data to codes and returns the span of the codes.
+  Index encode_labels(std::vector<std::vector<std::pair<Char, Index>>>& data, bool dense_alphabet){
+    std::array<std::size_t, LABEL_RANGE> count{};
+    for(auto& edges : data){
+      for(auto [key, to] : edges){
+        ++count[key];
+      }
+    }
+    std::vector<Char> order;
+    for(Index key = 0; key < LABEL_RANGE; ++key){
+      if(count[key] != 0){
+        order.emplace_back(key);
+      }
+    }
+    std::vector<Char> vec(LABEL_RANGE);
+    if(!dense_alphabet || order.size() > MAX_DENSE_LABELS){
+      std::iota(vec.begin(), vec.end(), 0);
+      codes = std::move(vec);
+      return LABEL_RANGE;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](Char a, Char b){
+      return count[a] > count[b];
+    });
+    std::fill(vec.begin(), vec.end(), order.size() + 1);
+    for(std::size_t i = 0; i < order.size(); ++i){
+      vec[order[i]] = i + 1;
+    }
+    for(auto& edges : data){
+      for(auto& [key, to] : edges){
+        key = vec[key];
+      }
+    }
+    codes = std::move(vec);
+    return order.size() + 2;
+  }
+  // the distinct edge labels in ascending order, the only keys for_each_child has to probe
+  MappableArray<Char> labels;
+  void collect_labels(const std::vector<std::vector<std::pair<Char, Index>>>& data){
+    std::array<bool, LABEL_RANGE> used{};
+    for(auto& edges : data){
+      for(auto [key, to] : edges){
+        used[key] = true;
+      }
+    }
+    std::vector<Char> vec;
+    for(Index key = 0; key < LABEL_RANGE; ++key){
+      if(used[key]){
+        vec.emplace_back(key);
+      }
+    }
+    labels = std::move(vec);
+  }
+  // the base of the nodes without edges if they all share one (the placement may give them distinct bases)
+  Index empty_base = NOT_FOUND;
+  void find_empty_base(const std::vector<std::vector<std::pair<Char, Index>>>& data, const std::vector<Index>& curs){
+    empty_base = NOT_FOUND;
+    for(Index i = 0; i < data.size(); ++i){
+      if(!data[i].empty()){
+        continue;
+      }
+      if(empty_base == NOT_FOUND){
+        empty_base = curs[i];
+      }
+      else if(empty_base != curs[i]){
+        empty_base = NOT_FOUND;
+        return;
+      }
+    }
+  }
+public:
+  DoubleArrayMaps() = default;
+  // the cell of the edge of idx labeled key (the cells are addressed by codes, not by bytes)
+  Index cell(Index idx, Char key) const{
+    return idx + code(key);
+  }
+  Index search(Index idx, Char key) const{
+    Char c = code(key);
+    return cells.search(idx + c, c);
+  }
+  // hints the cache about the cell that search(idx, key) is going to read
+  void prefetch(Index idx, Char key) const{
+    cells.prefetch(idx + code(key));
+  }
+  // calls f(key, val) for the edges of idx in ascending key order
+  template <typename F>
+  void for_each_child(Index idx, F&& f) const{
+    if(idx == empty_base){
+      return;
+    }
+    for(Char key : labels){
+      Index val = search(idx, key);
+      if(val != NOT_FOUND){
+        f(key, val);
+      }
+    }
+  }
+  // the cells keep the given targets, the returned vector maps each node to its base
+  static std::pair<DoubleArrayMaps, std::vector<Index>> construct_without_reindexing(std::vector<std::vector<std::pair<Char, Index>>>& data, DoubleArrayPlacement placement = DoubleArrayPlacement::Linear,
+                                                                                   bool dense_alphabet = true){
+    DoubleArrayMaps maps;
+    maps.collect_labels(data);
+    std::vector<std::vector<std::pair<Char, Index>>> coded = data;
+    Index range = maps.encode_labels(coded, dense_alphabet && !ByteCodes);
+    std::vector<Index> next;
+    std::vector<Char> check;
+    std::vector<Index> curs = place(coded, range, placement, false, next, check);
+    for(Index i = 0; i < coded.size(); ++i){
+      for(auto [key, to] : coded[i]){
+        next[curs[i] + key] = to;
+      }
+    }
+    maps.cells = Cells(std::move(next), std::move(check));
+    maps.find_empty_base(data, curs);
+    return {maps, curs};
+  }
+  // the cells point to the base of their targets (targets with the tail flag are kept as they are),
+  // so a node is identified by its base; the root gets base 0
+  static std::pair<DoubleArrayMaps, std::vector<Index>> construct_with_reindexing(std::vector<std::vector<std::pair<Char, Index>>>& data, DoubleArrayPlacement placement = DoubleArrayPlacement::Linear,
+                                                                                   bool dense_alphabet = true){
+    DoubleArrayMaps maps;
+    maps.collect_labels(data);
+    std::vector<std::vector<std::pair<Char, Index>>> coded = data;
+    Index range = maps.encode_labels(coded, dense_alphabet && !ByteCodes);
+    std::vector<Index> next;
+    std::vector<Char> check;
+    std::vector<Index> curs = place(coded, range, placement, true, next, check);
+    for(Index i = 0; i < coded.size(); ++i){
+      for(auto [key, to] : coded[i]){
+        next[curs[i] + key] = (to & TAIL_FLAG) ? to : curs[to];
+      }
+    }
+    maps.cells = Cells(std::move(next), std::move(check));
+    maps.find_empty_base(data, curs);
+    return {maps, curs};
+  }
+  // ratio of the cells that hold an edge
+  double fill_rate() const{
+    if(size() == 0){
+      return 0.0;
+    }
+    std::size_t used = 0;
+    for(Index i = 0; i < size(); ++i){
+      used += cells.check_at(i) != NULL_CHAR;
+    }
+    return 1.0 * used / size();
+  }
+  Index size() const{
+    return cells.size();
+  }
+  std::size_t memory_usage() const{
+    return cells.memory_usage() + sizeof(Char) * (codes.size() + labels.size());
+  }
+  // number of codes of the labels (σ, or 256 without the dense alphabet). NULL_CHAR is no label,
+  // so its code is σ + 1 with the dense alphabet and 0 otherwise
+  Index alphabet_size() const{
+    return codes.empty() || codes[0] == 0 ? LABEL_RANGE : codes[0] - 1;
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.cells, self.codes, self.labels, self.empty_base);
+  }
+};
+
+struct LabeledEdge{
+  Char key;
+  StoredIndex val;
+};
+
+// edge stores of BinarySearchMaps. The edges of all nodes are concatenated, each node sorted by key,
+// and find(l, r, key) looks up key among the edges [l, r) of one node.
+
+// (key, target) pairs, searched by bisection that falls back to a linear scan on short ranges
+class SortedEdges{
+  MappableArray<LabeledEdge> elms;
+public:
+  static constexpr const char* name = "Sorted";
+  SortedEdges() = default;
+  SortedEdges(const std::vector<Char>& keys, const std::vector<Index>& vals){
+    std::vector<LabeledEdge> vec(keys.size());
+    for(std::size_t i = 0; i < keys.size(); ++i){
+      vec[i] = {keys[i], vals[i]};
+    }
+    elms = std::move(vec);
+  }
+  Index find(Index l, Index r, Char key) const{
+    constexpr int linear_search_border = 5;
+    while(r - l > linear_search_border){
+      Index mid = (r + l) >> 1u;
+      if(elms[mid].key == key){
+        return elms[mid].val;
+      }else if(elms[mid].key < key){
+        l = mid;
+      }else{
+        r = mid;
+      }
+    }
+    for(unsigned int i = l; i < r; ++i){
+      if(elms[i].key == key){
+        return elms[i].val;
+      }
+      else if(key < elms[i].key){
+        return NOT_FOUND;
+      }
+    }
+    return NOT_FOUND;
+  }
+  Char key_at(Index i) const{
+    return elms[i].key;
+  }
+  Index val_at(Index i) const{
+    return elms[i].val;
+  }
+  Index size() const{
+    return elms.size();
+  }
+  std::size_t memory_usage() const{
+    return sizeof(LabeledEdge) * elms.size();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.elms);
+  }
+};
+
+// keys and targets in two parallel arrays; the keys of a node are compared SIMD_WIDTH at a time
+// with a byte compare and a movemask, so a node with up to SIMD_WIDTH edges takes a single probe
+class SimdEdges{
+#if defined(__AVX2__)
+  static constexpr Index SIMD_WIDTH = 32;
+#elif defined(__SSE2__)
+  static constexpr Index SIMD_WIDTH = 16;
+#else
+  static constexpr Index SIMD_WIDTH = 1;
+#endif
+  // keys is padded by SIMD_WIDTH bytes so that the last block of a node can be loaded whole
+  MappableArray<Char> keys;
+  MappableArray<StoredIndex> vals;
+public:
+  static constexpr const char* name = "Simd";
+  SimdEdges() = default;
+  SimdEdges(std::vector<Char> keys, const std::vector<Index>& vals) : vals(vals){
+    keys.resize(keys.size() + SIMD_WIDTH, NULL_CHAR);
+    this->keys = std::move(keys);
+  }
+  Index find(Index l, Index r, Char key) const{
+#if defined(__AVX2__) || defined(__SSE2__)
+    for(Index i = l; i < r; i += SIMD_WIDTH){
+#if defined(__AVX2__)
+      __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys.data() + i));
+      std::uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(key)));
+#else
+      __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys.data() + i));
+      std::uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(key)));
+#endif
+      if(r - i < SIMD_WIDTH){
+        mask &= (1u << (r - i)) - 1;
+      }
+      if(mask != 0){
+        return vals[i + __builtin_ctz(mask)];
+      }
+    }
+#else
+    for(Index i = l; i < r; ++i){
+      if(keys[i] == key){
+        return vals[i];
+      }
+    }
+#endif
+    return NOT_FOUND;
+  }
+  Char key_at(Index i) const{
+    return keys[i];
+  }
+  Index val_at(Index i) const{
+    return vals[i];
+  }
+  Index size() const{
+    return vals.size();
+  }
+  std::size_t memory_usage() const{
+    return sizeof(Char) * keys.size() + sizeof(StoredIndex) * vals.size();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.keys, self.vals);
+  }
+};
+
+// offset directories of BinarySearchMaps: range(idx) returns the [l, r) range of the edges of node idx
+
+// a bit vector with a one per node followed by a zero per edge. The one of node idx has idx ones before it,
+// so l = select(idx) - idx and r = select(idx + 1) - idx - 1. select starts at the word of the closest sampled one
+// (every SELECT_SAMPLE-th) and counts the ones of the words from there; the samples are stored like the bits
+class SelectDirectory{
+  static constexpr std::size_t SELECT_SAMPLE = 64;
+  MappableArray<std::uint64_t> bits;
+  // for the ones of rank k * SELECT_SAMPLE: the word that holds it and the number of ones before that word
+  MappableArray<std::uint64_t> sample_words;
+  MappableArray<std::uint64_t> sample_ranks;
+  // the position of the one of rank k (from 0)
+  std::uint64_t select(std::uint64_t k) const{
+    std::size_t s = k / SELECT_SAMPLE;
+    std::size_t w = sample_words[s];
+    std::uint64_t ones = sample_ranks[s];
+    for(std::uint64_t count = std::popcount(bits[w]); ones + count <= k; count = std::popcount(bits[++w])){
+      ones += count;
+    }
+    return w * 64 + select_in_word(bits[w], k - ones);
+  }
+public:
+  static constexpr const char* name = "Select";
+  SelectDirectory() = default;
+  explicit SelectDirectory(const std::vector<Index>& offsets){
+    std::size_t len = offsets.back() + offsets.size();
+    std::vector<std::uint64_t> words(len / 64 + 1, 0);
+    std::vector<std::uint64_t> positions;
+    for(std::size_t i = 0; i < offsets.size(); ++i){
+      std::uint64_t pos = offsets[i] + i;
+      words[pos / 64] |= 1ull << (pos % 64);
+      if(i % SELECT_SAMPLE == 0){
+        positions.emplace_back(pos);
+      }
+    }
+    std::vector<std::uint64_t> word_ranks(words.size() + 1, 0);
+    for(std::size_t w = 0; w < words.size(); ++w){
+      word_ranks[w + 1] = word_ranks[w] + std::popcount(words[w]);
+    }
+    std::vector<std::uint64_t> swords, sranks;
+    for(std::uint64_t pos : positions){
+      swords.emplace_back(pos / 64);
+      sranks.emplace_back(word_ranks[pos / 64]);
+    }
+    bits = std::move(words);
+    sample_words = std::move(swords);
+    sample_ranks = std::move(sranks);
+  }
+  std::pair<Index, Index> range(Index idx) const{
+    Index l = select(idx) - idx;
+    Index r = select(idx + 1) - idx - 1;
+    return {l, r};
+  }
+  std::size_t memory_usage() const{
+    return sizeof(std::uint64_t) * (bits.size() + sample_words.size() + sample_ranks.size());
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.bits, self.sample_words, self.sample_ranks);
+  }
+};
+
+// the prefix sums of the fanouts, bit-packed to the width of the number of edges:
+// l and r are adjacent entries, so a node costs one random access instead of four
+class PrefixSumDirectory{
+  BitPackedArray offsets;
+public:
+  static constexpr const char* name = "PrefixSum";
+  PrefixSumDirectory() = default;
+  explicit PrefixSumDirectory(const std::vector<Index>& offsets) : offsets(offsets){}
+  std::pair<Index, Index> range(Index idx) const{
+    return {static_cast<Index>(offsets[idx]), static_cast<Index>(offsets[idx + 1])};
+  }
+  std::size_t memory_usage() const{
+    return offsets.memory_usage();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.offsets);
+  }
+};
+
+template <typename Edges = SortedEdges, typename Directory = SelectDirectory>
+class BinarySearchMaps{
+  Directory directory;
+  Edges elms;
+public:
+  explicit BinarySearchMaps(){}
+  static BinarySearchMaps static_construct(const std::vector<std::vector<std::pair<Char, Index>>>& _data){
+    std::vector<std::vector<std::pair<Char, Index>>> data = _data;
+    Index total_size = std::accumulate(data.begin(), data.end(), Index(0), [](Index sum, const std::vector<std::pair<Char, Index>>& vec){
+      return sum + vec.size();
+    });
+    std::vector<Index> offsets;
+    offsets.reserve(data.size() + 1);
+    std::vector<Char> keys;
+    std::vector<Index> vals;
+    keys.reserve(total_size);
+    vals.reserve(total_size);
+    for(Index i = 0; i < data.size(); ++i){
+      offsets.emplace_back(keys.size());
+      std::sort(data[i].begin(), data[i].end());
+      for(auto [key, val] : data[i]){
+        keys.push_back(key);
+        vals.push_back(val);
+      }
+    }
+    offsets.emplace_back(keys.size());
+    BinarySearchMaps maps;
+    maps.directory = Directory(offsets);
+    maps.elms = Edges(std::move(keys), std::move(vals));
+    return maps;
+  }
+  Index search(Index idx, Char key) const{
+    auto [l, r] = directory.range(idx);
+    return elms.find(l, r, key);
+  }
+  // calls f(key, val) for the edges of idx in ascending key order
+  template <typename F>
+  void for_each_child(Index idx, F&& f) const{
+    auto [l, r] = directory.range(idx);
+    for(Index i = l; i < r; ++i){
+      f(elms.key_at(i), elms.val_at(i));
+    }
+  }
+  Index size() const{
+    return elms.size();
+  }
+  std::size_t memory_usage() const{
+    return directory.memory_usage() + elms.memory_usage();
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.directory, self.elms);
+  }
+};
+
+// transition maps that choose the representation of each node by its fanout, since a few nodes near the root
+// have tens of children and almost all others one or two:
+// - linear: up to INLINE_LABELS sorted labels inline in the node header (8 bytes with 32-bit indexes), the targets at offset;
+//   the target of a single edge is the offset itself
+// - bitmap: a 256-bit bitmap of the labels with per-word ranks (BitmapNode); the target of a label is at first + its rank
+// - dense: a table of σ + 1 targets indexed by the dense code of the label (NOT_FOUND for the missing labels and the
+//   code σ of the bytes that label no edge), used when it takes at most DENSE_SPACE_FACTOR times the space of the bitmap
+class AdaptiveMaps{
+public:
+  static constexpr Char BITMAP = 254;
+  static constexpr Char DENSE = 255;
+  static constexpr Index INLINE_LABELS = sizeof(StoredIndex) == 8 ? 7 : 3;
+  static constexpr Index DENSE_SPACE_FACTOR = 2;
+  struct Node{
+    // the first target (linear, dense), the target (one edge) or the BitmapNode (bitmap)
+    StoredIndex offset;
+    // the number of inline labels, BITMAP or DENSE
+    Char kind;
+    Char labels[INLINE_LABELS];
+  };
+  struct BitmapNode{
+    std::uint64_t bits[4];
+    StoredIndex first;
+    // the number of labels in the words before each word
+    Char rank[4];
+  };
+private:
+  MappableArray<Node> nodes;
+  MappableArray<BitmapNode> bitmaps;
+  MappableArray<StoredIndex> vals;
+  // the dense code of every byte (σ for the bytes that label no edge) and the label of every code, in byte order
+  MappableArray<Char> codes;
+  MappableArray<Char> alphabet;
+public:
+  AdaptiveMaps() = default;
+  static AdaptiveMaps static_construct(const std::vector<std::vector<std::pair<Char, Index>>>& _data){
+    std::vector<std::vector<std::pair<Char, Index>>> data = _data;
+    std::array<bool, LABEL_RANGE> used{};
+    for(auto& edges : data){
+      std::sort(edges.begin(), edges.end());
+      for(auto [key, val] : edges){
+        used[key] = true;
+      }
+    }
+    std::vector<Char> alphabet;
+    std::vector<Char> codes(LABEL_RANGE);
+    for(Index c = 0; c < LABEL_RANGE; ++c){
+      if(used[c]){
+        alphabet.push_back(c);
+      }
+    }
+    Index sigma = alphabet.size();
+    for(Index c = 0; c < LABEL_RANGE; ++c){
+      codes[c] = used[c] ? std::lower_bound(alphabet.begin(), alphabet.end(), c) - alphabet.begin() : sigma;
+    }
+    std::vector<Node> nodes(data.size());
+    std::vector<BitmapNode> bitmaps;
+    // in the stored element type, so that the array is moved into maps.vals and not converted
+    std::vector<StoredIndex> vals;
+    for(Index i = 0; i < data.size(); ++i){
+      auto& edges = data[i];
+      Index fanout = edges.size();
+      std::size_t bitmap_space = sizeof(BitmapNode) + sizeof(StoredIndex) * fanout;
+      std::size_t dense_space = sizeof(StoredIndex) * (sigma + 1);
+      Node& node = nodes[i];
+      if(fanout <= INLINE_LABELS){
+        node.offset = fanout == 1 ? edges[0].second : vals.size();
+        node.kind = fanout;
+        for(Index j = 0; j < fanout; ++j){
+          node.labels[j] = edges[j].first;
+          if(fanout > 1){
+            vals.push_back(edges[j].second);
+          }
+        }
+      }
+      else if(dense_space <= DENSE_SPACE_FACTOR * bitmap_space){
+        node.offset = vals.size();
+        node.kind = DENSE;
+        vals.resize(vals.size() + sigma + 1, NOT_FOUND);
+        for(auto [key, val] : edges){
+          vals[node.offset + codes[key]] = val;
+        }
+      }
+      else{
+        node.offset = bitmaps.size();
+        node.kind = BITMAP;
+        BitmapNode bitmap{};
+        bitmap.first = vals.size();
+        for(auto [key, val] : edges){
+          bitmap.bits[key >> 6u] |= std::uint64_t(1) << (key & 63u);
+          vals.push_back(val);
+        }
+        for(Index w = 1; w < 4; ++w){
+          bitmap.rank[w] = bitmap.rank[w - 1] + std::popcount(bitmap.bits[w - 1]);
+        }
+        bitmaps.push_back(bitmap);
+      }
+    }
+    AdaptiveMaps maps;
+    maps.nodes = std::move(nodes);
+    maps.bitmaps = std::move(bitmaps);
+    maps.vals = std::move(vals);
+    maps.codes = std::move(codes);
+    maps.alphabet = std::move(alphabet);
+    return maps;
+  }
+  Index search(Index idx, Char key) const{
+    const Node& node = nodes[idx];
+    if(node.kind <= INLINE_LABELS){
+      for(Index j = 0; j < node.kind; ++j){
+        if(node.labels[j] == key){
+          return node.kind == 1 ? Index(node.offset) : Index(vals[node.offset + j]);
+        }
+      }
+      return NOT_FOUND;
+    }
+    if(node.kind == BITMAP){
+      const BitmapNode& bitmap = bitmaps[node.offset];
+      std::uint64_t word = bitmap.bits[key >> 6u];
+      std::uint64_t bit = std::uint64_t(1) << (key & 63u);
+      if((word & bit) == 0){
+        return NOT_FOUND;
+      }
+      return vals[bitmap.first + bitmap.rank[key >> 6u] + std::popcount(word & (bit - 1))];
+    }
+    return vals[node.offset + codes[key]];
+  }
+  // calls f(key, val) for the edges of idx in ascending key order
+  template <typename F>
+  void for_each_child(Index idx, F&& f) const{
+    const Node& node = nodes[idx];
+    if(node.kind <= INLINE_LABELS){
+      for(Index j = 0; j < node.kind; ++j){
+        f(node.labels[j], node.kind == 1 ? Index(node.offset) : Index(vals[node.offset + j]));
+      }
+    }
+    else if(node.kind == BITMAP){
+      const BitmapNode& bitmap = bitmaps[node.offset];
+      Index j = bitmap.first;
+      for(Index w = 0; w < 4; ++w){
+        for(std::uint64_t bits = bitmap.bits[w]; bits != 0; bits &= bits - 1){
+          f(Char(w * 64 + std::countr_zero(bits)), vals[j++]);
+        }
+      }
+    }
+    else{
+      for(Index c = 0; c < alphabet.size(); ++c){
+        Index val = vals[node.offset + c];
+        if(val != NOT_FOUND){
+          f(alphabet[c], val);
+        }
+      }
+    }
+  }
+  Index size() const{
+    return nodes.size();
+  }
+  // the number of nodes, edges and bytes of each representation
+  void print_stats() const{
+    std::array<std::size_t, 3> node_count{}, edge_count{}, memory{};
+    for(Index i = 0; i < nodes.size(); ++i){
+      Index kind = nodes[i].kind <= INLINE_LABELS ? 0 : nodes[i].kind == BITMAP ? 1 : 2;
+      Index fanout = 0;
+      for_each_child(i, [&](Char, Index){ ++fanout; });
+      ++node_count[kind];
+      edge_count[kind] += fanout;
+      memory[kind] += sizeof(Node) + (kind == 0 ? sizeof(StoredIndex) * (fanout > 1 ? fanout : 0)
+                                      : kind == 1 ? sizeof(BitmapNode) + sizeof(StoredIndex) * fanout
+                                      : sizeof(StoredIndex) * (alphabet.size() + 1));
+    }
+    const char* names[] = {"linear", "bitmap", "dense"};
+    std::clog << "--------------------------------" << std::endl;
+    std::clog << "alphabet size: " << alphabet.size() << std::endl;
+    for(Index kind = 0; kind < 3; ++kind){
+      std::clog << names[kind] << " nodes: " << node_count[kind] << ", edges: " << edge_count[kind]
+                << ", memory: " << memory[kind] << "[B]" << std::endl;
+    }
+    std::clog << "--------------------------------" << std::endl;
+  }
+  std::size_t memory_usage() const{
+    return sizeof(Node) * nodes.size()
+           + sizeof(BitmapNode) * bitmaps.size()
+           + sizeof(StoredIndex) * vals.size()
+           + sizeof(Char) * (codes.size() + alphabet.size());
+  }
+  template <typename Self, typename Archive>
+  static void serialize(Self& self, Archive& ar){
+    ar(self.nodes, self.bitmaps, self.vals, self.codes, self.alphabet);
+  }
+};
+
+template <TransitionMap T>
+T construct_map(std::vector<std::pair<Char, Index>>& data){
+  T map;
+  for(auto [key, val] : data){
+    map.insert(key, val);
+  }
+  return map;
+}
+
+template<TransitionMap U>
+MapVector<U> construct_maps(std::vector<std::vector<std::pair<Char, Index>>>& data){
+  MapVector<U> maps(data.size());
+  for(Index i = 0; i < data.size(); ++i){
+    maps[i] = construct_map<U>(data[i]);
+  }
+  return maps;
+}
+
+template <TransitionMaps T> requires std::constructible_from<T, int>
+T construct_maps(std::vector<std::vector<std::pair<Char, Index>>>& data){
+  T maps(data.size());
+  for(Index i = 0; i < data.size(); ++i){
+    for(auto [key, val] : data[i]){
+      maps.insert(i, key, val);
+    }
+  }
+  return maps;
+}
+
+#endif //PACKED_ADFA_UTILS_HPP
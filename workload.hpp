@@ -0,0 +1,192 @@
+//
+// Created by shibh308 on 2026/10/16.
+//
+
+#ifndef PACKED_ADFA_WORKLOAD_HPP
+#define PACKED_ADFA_WORKLOAD_HPP
+
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <iostream>
+#include <cmath>
+#include "utils.hpp"
+
+struct WorkloadConfig {
+  // number of queries (0: as many as there are keys and unseen keys)
+  std::size_t queries = 0;
+  // ratio of the negative queries (negative: the ratio of the unseen keys)
+  double negative_ratio = -1;
+  // exponent s of the Zipf distribution P(rank r) ~ 1 / r^s over the keys in split order
+  // (0: the keys are walked in split order, so every key is queried once when the counts match)
+  double zipf_exponent = 0;
+  // fractions of the negative queries that are a key with one character replaced, a proper prefix of a key
+  // and random characters; the rest are unseen keys
+  double perturbed = 0;
+  double truncated = 0;
+  double junk = 0;
+  // position of the replaced character of the perturbed keys (negative: uniformly random)
+  int perturb_position = -1;
+  std::uint64_t seed = 1;
+};
+
+// query streams generated from the keys of an index and held-out (unseen) keys.
+// The positive queries are keys; the negative queries are unseen keys or strings derived from the keys
+// that are checked not to be keys. The generated strings are stored in the workload, the others point to the keys.
+class QueryWorkload{
+  // the generated strings back to back, referenced by (offset, length) until all of them exist
+  String arena;
+  std::vector<std::pair<std::size_t, std::size_t>> generated;
+  StringViews positive_queries, negative_queries;
+  // samples key indices, Zipf distributed over the split order
+  class KeySampler{
+    std::vector<double> cdf;
+    std::size_t cursor = 0;
+    std::size_t n;
+  public:
+    KeySampler(std::size_t n, double exponent) : n(n){
+      if(exponent > 0){
+        cdf.resize(n);
+        double sum = 0;
+        for(std::size_t r = 0; r < n; ++r){
+          sum += std::pow(r + 1.0, -exponent);
+          cdf[r] = sum;
+        }
+      }
+    }
+    std::size_t operator()(std::mt19937_64& rand){
+      if(cdf.empty()){
+        return cursor++ % n;
+      }
+      double u = std::uniform_real_distribution<double>(0, cdf.back())(rand);
+      return std::min<std::size_t>(std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin(), n - 1);
+    }
+  };
+public:
+  QueryWorkload(const StringViews& keys, const StringViews& unseen, const WorkloadConfig& config){
+    assert(!keys.empty());
+    std::mt19937_64 rand(config.seed);
+    std::size_t queries = config.queries != 0 ? config.queries : keys.size() + unseen.size();
+    double negative_ratio = config.negative_ratio >= 0 ? config.negative_ratio : 1.0 * unseen.size() / (keys.size() + unseen.size());
+    std::size_t num_negative = std::llround(queries * std::clamp(negative_ratio, 0.0, 1.0));
+    KeySampler key_sampler(keys.size(), config.zipf_exponent);
+    positive_queries.reserve(queries - num_negative);
+    for(std::size_t i = num_negative; i < queries; ++i){
+      positive_queries.emplace_back(keys[key_sampler(rand)]);
+    }
+
+    StringViews sorted_keys = keys;
+    std::sort(sorted_keys.begin(), sorted_keys.end(), view_less);
+    // the characters of the keys, without EOW
+    std::vector<Char> alphabet;
+    std::array<bool, LABEL_RANGE> occur{};
+    for(StringView key : keys){
+      for(std::size_t i = 0; i + 1 < key.size(); ++i){
+        occur[key[i]] = true;
+      }
+    }
+    for(Index c = 0; c < LABEL_RANGE; ++c){
+      if(occur[c] && c != EOW){
+        alphabet.emplace_back(c);
+      }
+    }
+    auto random_char = [&](){
+      return alphabet[std::uniform_int_distribution<std::size_t>(0, alphabet.size() - 1)(rand)];
+    };
+    // appends the candidate to the arena if it is not a key
+    String candidate;
+    auto try_generate = [&](){
+      assert(!candidate.empty() && candidate.back() == EOW);
+      if(std::binary_search(sorted_keys.begin(), sorted_keys.end(), StringView(candidate), view_less)){
+        return false;
+      }
+      generated.emplace_back(arena.size(), candidate.size());
+      arena.insert(arena.end(), candidate.begin(), candidate.end());
+      return true;
+    };
+    auto make_perturbed = [&](StringView key){
+      // a key that is only EOW has no character to replace
+      if(key.size() < 2 || alphabet.size() < 2){
+        return false;
+      }
+      std::size_t pos = config.perturb_position >= 0 ? std::min<std::size_t>(config.perturb_position, key.size() - 2)
+                                                    : std::uniform_int_distribution<std::size_t>(0, key.size() - 2)(rand);
+      candidate.assign(key.begin(), key.end());
+      do{
+        candidate[pos] = random_char();
+      }while(candidate[pos] == key[pos]);
+      return try_generate();
+    };
+    auto make_truncated = [&](StringView key){
+      if(key.size() < 3){
+        return false;
+      }
+      std::size_t len = std::uniform_int_distribution<std::size_t>(1, key.size() - 2)(rand);
+      candidate.assign(key.begin(), key.begin() + len);
+      candidate.emplace_back(EOW);
+      return try_generate();
+    };
+    auto make_junk = [&](StringView key){
+      if(alphabet.empty()){
+        return false;
+      }
+      candidate.clear();
+      for(std::size_t i = 0; i + 1 < std::max<std::size_t>(key.size(), 2); ++i){
+        candidate.emplace_back(random_char());
+      }
+      candidate.emplace_back(EOW);
+      return try_generate();
+    };
+    constexpr std::size_t MAX_ATTEMPTS = 16;
+    std::size_t unseen_cursor = 0;
+    negative_queries.reserve(num_negative);
+    for(std::size_t i = 0; i < num_negative; ++i){
+      double u = std::uniform_real_distribution<double>(0, 1)(rand);
+      bool derived = false;
+      for(std::size_t attempt = 0; attempt < MAX_ATTEMPTS && !derived; ++attempt){
+        StringView key = keys[key_sampler(rand)];
+        if(u < config.perturbed){
+          derived = make_perturbed(key);
+        }
+        else if(u < config.perturbed + config.truncated){
+          derived = make_truncated(key);
+        }
+        else if(u < config.perturbed + config.truncated + config.junk || unseen.empty()){
+          derived = make_junk(key);
+        }
+        else{
+          break;
+        }
+      }
+      if(derived){
+        // a null view, pointed to the arena once it stops growing
+        negative_queries.emplace_back();
+      }
+      else if(!unseen.empty()){
+        negative_queries.emplace_back(unseen[unseen_cursor++ % unseen.size()]);
+      }
+    }
+    // slack for the word-wise reads of get_lcp past the end of the last string
+    arena.resize(arena.size() + SECTION_SLACK, NULL_CHAR);
+    auto next = generated.begin();
+    for(auto& query : negative_queries){
+      if(query.data() == nullptr){
+        query = StringView(arena.data() + next->first, next->second);
+        ++next;
+      }
+    }
+    std::clog << "Workload: " << positive_queries.size() << " positive queries (Zipf exponent " << config.zipf_exponent << "), "
+              << negative_queries.size() << " negative queries (" << generated.size() << " generated)" << std::endl;
+    std::clog << std::endl;
+  }
+  QueryWorkload(const QueryWorkload&) = delete;
+  QueryWorkload& operator=(const QueryWorkload&) = delete;
+  const StringViews& positive() const{
+    return positive_queries;
+  }
+  const StringViews& negative() const{
+    return negative_queries;
+  }
+};
+
+#endif //PACKED_ADFA_WORKLOAD_HPP